@@ -109,13 +109,29 @@ catch(std::exception const& e)
 
 void ApplicationBase::run()
 {
+    auto& ecs {ECS::get()};
+
+    //Removals have to be remembered until every system has had a chance to see them.
+    U32 previousFrameTick {0};
+
     while( ! mWindow.shouldClose() )
     {
         auto startTime {startOfLoop()};
+        auto const frameTick {ecs.getChangeTick()};
 
         mWindow.displayTitleFPS(mFrameTime);
         //imguiDraw();//call the app defined override for imguiDraw
 
+        mSystems.run(mFrameTime);
+
+        //Sync point. Apply the structural changes the systems recorded.
+        ecs.flushCommands();
+        ecs.getEventBus().drain();
+        mTransformHierarchy.update();
+        if(mDeltaRecorder.isRecording()) {mDeltaRecorder.captureFrame();}
+        ecs.trimRemovedLogs(previousFrameTick);
+        previousFrameTick = frameTick;
+
         mFrameTime = endOfLoop(startTime);
     }
 }
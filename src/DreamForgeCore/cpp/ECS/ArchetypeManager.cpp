@@ -0,0 +1,258 @@
+#include "ArchetypeManager.hpp"
+#include "errorHandling.hpp"
+#include <cstring>
+#include <format>
+#include <utility>
+
+namespace DF
+{
+
+//Archetype chunks are untyped memory, so components are moved around with memcpy and
+//default constructed through the function the ComponentRegistry keeps for each type.
+static ComponentInfo const& getInfo(size_t componentID)
+{
+    return ComponentRegistry::get().getInfo(static_cast<Index_t>(componentID));
+}
+
+static size_t alignUp(size_t offset, size_t alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+Signature_t ArchetypeManager::getSignature(Entity const& entity) const
+{
+    if(entity.getIndex() >= mLocations.getCapacity())
+        return {};
+
+    auto const archetypeIdx {mLocations[entity.getIndex()].archetype};
+    return archetypeIdx == sNoArchetype ? Signature_t{} : mArchetypes[archetypeIdx]->signature;
+}
+
+void* ArchetypeManager::getComponentImpl(Entity const& entity, Index_t componentID)
+{
+    if(entity.getIndex() >= mLocations.getCapacity())
+        return nullptr;
+
+    auto const& location {mLocations[entity.getIndex()]};
+    if(location.archetype == sNoArchetype)
+        return nullptr;
+
+    auto const& archetype {*mArchetypes[location.archetype]};
+    if(archetype.columnOffsets[componentID] == sNoColumn)
+        return nullptr;
+
+    return archetype.getColumn(archetype.chunks[location.chunk], componentID) +
+        location.row * getInfo(componentID).size;
+}
+
+ComponentTicks* ArchetypeManager::getTicksImpl(Entity const& entity, Index_t componentID)
+{
+    if(entity.getIndex() >= mLocations.getCapacity())
+        return nullptr;
+
+    auto const& location {mLocations[entity.getIndex()]};
+    if(location.archetype == sNoArchetype)
+        return nullptr;
+
+    auto const& archetype {*mArchetypes[location.archetype]};
+    if(archetype.tickOffsets[componentID] == sNoColumn)
+        return nullptr;
+
+    return archetype.getTicks(archetype.chunks[location.chunk], componentID) + location.row;
+}
+
+bool ArchetypeManager::markChanged(Entity const& entity, Index_t componentID, U32 tick)
+{
+    auto* ticks {getTicksImpl(entity, componentID)};
+    if(!ticks || ticks->changed == tick) {return false;}
+
+    ticks->changed = tick;
+
+    //Parallel systems can mark rows of the same chunk, but they all store the newest tick there is.
+    auto const& location {mLocations[entity.getIndex()]};
+    auto& chunk {mArchetypes[location.archetype]->chunks[location.chunk]};
+    std::atomic_ref{chunk.newestTicks[componentID].changed}.store(tick, std::memory_order_relaxed);
+    return true;
+}
+
+void ArchetypeManager::seek(Cursor& cursor, Signature_t required, Signature_t excluded) const
+{
+    for(; cursor.archetype < mArchetypes.size(); ++cursor.archetype, cursor.chunk = 0, cursor.row = 0)
+    {
+        auto const& archetype {*mArchetypes[cursor.archetype]};
+
+        if((archetype.signature & required) != required) {continue;}
+        if((archetype.signature & excluded).any()) {continue;}
+
+        for(; cursor.chunk < archetype.chunks.size(); ++cursor.chunk, cursor.row = 0)
+        {
+            if(cursor.row < archetype.chunks[cursor.chunk].count)
+                return;
+        }
+    }
+
+    cursor = endCursor();
+}
+
+void ArchetypeManager::insertComponentByID(Entity const& entity, Index_t componentID, void const* value, U32 tick)
+{
+    changeSignature(entity, getSignature(entity).set(componentID), tick);
+    std::memcpy(getComponentImpl(entity, componentID), value, getInfo(componentID).size);
+}
+
+void ArchetypeManager::removeComponentByID(Entity const& entity, Index_t componentID)
+{
+    changeSignature(entity, getSignature(entity).reset(componentID));
+}
+
+U32 ArchetypeManager::getOrCreateArchetype(Signature_t signature)
+{
+    if(auto it {mArchetypeLookup.find(signature.to_ullong())}; it != mArchetypeLookup.end())
+        return it->second;
+
+    auto archetype {std::make_unique<Archetype>()};
+    archetype->signature = signature;
+    archetype->columnOffsets.fill(sNoColumn);
+    archetype->tickOffsets.fill(sNoColumn);
+
+    size_t rowBytes {sizeof(Entity)};
+    size_t worstCasePadding {0};
+    for(size_t id = 0; id < MAX_NUM_COMPONENT_TYPES; ++id)
+    {
+        if(!signature.test(id)) {continue;}
+        rowBytes += getInfo(id).size + sizeof(ComponentTicks);
+        worstCasePadding += getInfo(id).alignment + alignof(ComponentTicks);
+    }
+
+    //Every column is padded out to its alignment, so leave room for that.
+    if(worstCasePadding + rowBytes > sChunkBytes)
+    {
+        throw DFException{std::format("could not make an archetype, one row of its components needs {} bytes "
+            "but a chunk only has {}", worstCasePadding + rowBytes, sChunkBytes)};
+    }
+    auto const rows {(sChunkBytes - worstCasePadding) / rowBytes};
+    archetype->rowsPerChunk = static_cast<U32>(rows);
+
+    size_t offset {sizeof(Entity) * rows};
+    for(size_t id = 0; id < MAX_NUM_COMPONENT_TYPES; ++id)
+    {
+        if(!signature.test(id)) {continue;}
+        offset = alignUp(offset, getInfo(id).alignment);
+        archetype->columnOffsets[id] = static_cast<U32>(offset);
+        offset += getInfo(id).size * rows;
+    }
+
+    //The ticks go after all of the components so the component columns stay
+    //tightly packed for queries that dont care about changes.
+    for(size_t id = 0; id < MAX_NUM_COMPONENT_TYPES; ++id)
+    {
+        if(!signature.test(id)) {continue;}
+        offset = alignUp(offset, alignof(ComponentTicks));
+        archetype->tickOffsets[id] = static_cast<U32>(offset);
+        offset += sizeof(ComponentTicks) * rows;
+    }
+
+    auto const idx {static_cast<U32>(mArchetypes.size())};
+    mArchetypes.push_back(std::move(archetype));
+    mArchetypeLookup.emplace(signature.to_ullong(), idx);
+    return idx;
+}
+
+ArchetypeManager::Location ArchetypeManager::pushRow(U32 archetypeIdx, Entity const& entity)
+{
+    auto& archetype {*mArchetypes[archetypeIdx]};
+
+    if(archetype.chunks.empty() || archetype.chunks.back().count == archetype.rowsPerChunk)
+    {
+        archetype.chunks.emplace_back().memory.reset(static_cast<std::byte*>(
+            ::operator new[](sChunkBytes, std::align_val_t{sChunkAlignment})));
+    }
+
+    auto& chunk {archetype.chunks.back()};
+    Location const location {archetypeIdx, static_cast<U32>(archetype.chunks.size() - 1), chunk.count++};
+    archetype.getEntities(chunk)[location.row] = entity;
+    return location;
+}
+
+void ArchetypeManager::eraseRow(Location const& location)
+{
+    auto& archetype {*mArchetypes[location.archetype]};
+    auto& lastChunk {archetype.chunks.back()};
+    auto const lastRow {lastChunk.count - 1};
+    auto const lastChunkIdx {static_cast<U32>(archetype.chunks.size() - 1)};
+
+    //The ordering of the rows doesnt matter, so just copy the last row into the hole.
+    if(location.chunk != lastChunkIdx || location.row != lastRow)
+    {
+        auto& holeChunk {archetype.chunks[location.chunk]};
+        auto const moved {archetype.getEntities(lastChunk)[lastRow]};
+        archetype.getEntities(holeChunk)[location.row] = moved;
+
+        for(size_t id = 0; id < MAX_NUM_COMPONENT_TYPES; ++id)
+        {
+            if(archetype.columnOffsets[id] == sNoColumn) {continue;}
+            auto const size {getInfo(id).size};
+            std::memcpy(archetype.getColumn(holeChunk, id) + location.row * size,
+                archetype.getColumn(lastChunk, id) + lastRow * size, size);
+            auto const& movedTicks {archetype.getTicks(lastChunk, id)[lastRow]};
+            archetype.getTicks(holeChunk, id)[location.row] = movedTicks;
+            holeChunk.raiseNewestTicks(static_cast<Index_t>(id), movedTicks);
+        }
+
+        mLocations[moved.getIndex()] = location;
+    }
+
+    if(--lastChunk.count == 0)
+        archetype.chunks.pop_back();
+}
+
+void ArchetypeManager::changeSignature(Entity const& entity, Signature_t newSignature, U32 tick)
+{
+    mLocations.reserve(entity.getIndex() + 1);
+    auto& location {mLocations[entity.getIndex()]};
+
+    auto const oldSignature {location.archetype == sNoArchetype ?
+        Signature_t{} : mArchetypes[location.archetype]->signature};
+
+    if(oldSignature == newSignature)
+        return;
+
+    Location newLocation{};
+    if(newSignature.any())
+    {
+        newLocation = pushRow(getOrCreateArchetype(newSignature), entity);
+        auto const& newArchetype {*mArchetypes[newLocation.archetype]};
+        auto& newChunk {mArchetypes[newLocation.archetype]->chunks[newLocation.chunk]};
+
+        for(size_t id = 0; id < MAX_NUM_COMPONENT_TYPES; ++id)
+        {
+            if(!newSignature.test(id)) {continue;}
+
+            auto const size {getInfo(id).size};
+            auto* dst {newArchetype.getColumn(newChunk, id) + newLocation.row * size};
+            auto& dstTicks {newArchetype.getTicks(newChunk, id)[newLocation.row]};
+
+            if(oldSignature.test(id))
+            {
+                auto const& oldArchetype {*mArchetypes[location.archetype]};
+                auto const& oldChunk {oldArchetype.chunks[location.chunk]};
+                std::memcpy(dst, oldArchetype.getColumn(oldChunk, id) + location.row * size, size);
+                dstTicks = oldArchetype.getTicks(oldChunk, id)[location.row];
+            }
+            else
+            {
+                getInfo(id).defaultConstruct(dst);
+                dstTicks = {.added = tick, .changed = tick};
+            }
+
+            newChunk.raiseNewestTicks(static_cast<Index_t>(id), dstTicks);
+        }
+    }
+
+    if(location.archetype != sNoArchetype)
+        eraseRow(location);
+
+    location = newLocation;
+}
+
+}
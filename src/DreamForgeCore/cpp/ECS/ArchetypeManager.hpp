@@ -0,0 +1,401 @@
+#pragma once
+#include "Components.hpp"
+#include "EntityManager.hpp"
+#include "ChunkedArray.hpp"
+#include "ChangeTracking.hpp"
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <span>
+#include <cstddef>
+#include <new>
+#include <unordered_map>
+
+namespace DF
+{
+
+//An alternative to ComponentManager that stores entities grouped by signature.
+//Every unique signature gets an archetype, and the entities of an archetype live
+//in fixed size chunks laid out as structure of arrays:
+//[Entity x rows][ComponentA x rows][ComponentB x rows]...[ComponentTicks x rows per component]
+//A query that reads A and B walks the matching archetypes chunk by chunk and streams
+//through their columns with no per entity lookups. The tradeoff is that adding or
+//removing a component moves the entity's components into another archetype.
+class ArchetypeManager
+{
+public:
+
+    //At least one row of every archetype has to fit in a chunk,
+    //making an archetype with bigger components than that throws a DFException.
+    inline constexpr static size_t sChunkBytes{16 * 1024};
+    inline constexpr static size_t sChunkAlignment{64};
+
+    ArchetypeManager()=default;
+    ~ArchetypeManager()=default;
+
+    ArchetypeManager(ArchetypeManager const&)=delete;
+    ArchetypeManager(ArchetypeManager&&)=delete;
+    ArchetypeManager& operator=(ArchetypeManager const&)=delete;
+    ArchetypeManager& operator=(ArchetypeManager&&)=delete;
+
+    //The new components are default constructed and stamped with tick.
+    template <typename ...ComponentTs>
+    void insertComponents(Entity const& entity, U32 tick)
+    {
+        Signature_t added;
+        (added.set(GetIDFromType<ComponentTs>()), ...);
+        changeSignature(entity, getSignature(entity) | added, tick);
+    }
+
+    template <typename ...ComponentTs>
+    void removeComponents(Entity const& entity)
+    {
+        Signature_t removed;
+        (removed.set(GetIDFromType<ComponentTs>()), ...);
+        changeSignature(entity, getSignature(entity) & ~removed);
+    }
+
+    void removeAllComponents(Entity const& entity)
+    {
+        changeSignature(entity, Signature_t{});
+    }
+
+    //Runtime versions of insertComponents and removeComponents for when the type is only
+    //known by ID (e.g. replaying recorded commands). value points to a componentID type to copy in.
+    void insertComponentByID(Entity const& entity, Index_t componentID, void const* value, U32 tick);
+    void removeComponentByID(Entity const& entity, Index_t componentID);
+
+    template <typename ComponentT>
+    [[nodiscard]] NonOwningPtr<ComponentT> getComponent(Entity const& entity)
+    {
+        return static_cast<ComponentT*>(getComponentImpl(entity, GetIDFromType<ComponentT>()));
+    }
+
+    template <typename ComponentT>
+    [[nodiscard]] bool hasComponent(Entity const& entity) const
+    {
+        return getSignature(entity).test(GetIDFromType<ComponentT>());
+    }
+
+    //Returns nullptr if the entity doesnt have a ComponentT.
+    template <typename ComponentT>
+    [[nodiscard]] NonOwningPtr<ComponentTicks const> getTicks(Entity const& entity)
+    {
+        return getTicksImpl(entity, GetIDFromType<ComponentT>());
+    }
+
+    //Used to load snapshots (see ECSSnapshot.cpp). Moves the entity straight to the archetype
+    //of signature, default constructing and stamping with tick whatever it didnt have yet.
+    void setSignature(Entity const& entity, Signature_t signature, U32 tick)
+    {
+        changeSignature(entity, signature, tick);
+    }
+
+    //Returns nullptr if the entity doesnt have the component.
+    [[nodiscard]] void* getComponentByID(Entity const& entity, Index_t componentID)
+    {
+        return getComponentImpl(entity, componentID);
+    }
+
+    //Stamp the entity's component as changed at tick. Returns false if the entity
+    //doesnt have the component or it was already stamped with tick.
+    bool markChanged(Entity const& entity, Index_t componentID, U32 tick);
+
+    //Calls fn(std::span<Entity const>, std::byte const* column) once per chunk of every
+    //archetype that has componentID. The column holds one component per entity.
+    template <typename Func>
+    void eachColumnByID(Index_t componentID, Func&& fn) const
+    {
+        for(auto const& archetype : mArchetypes)
+        {
+            if(!archetype->signature.test(componentID)) {continue;}
+
+            for(auto const& chunk : archetype->chunks)
+            {
+                fn(std::span<Entity const>{archetype->getEntities(chunk), chunk.count},
+                    static_cast<std::byte const*>(archetype->getColumn(chunk, componentID)));
+            }
+        }
+    }
+
+    //Which rows of one chunk pass a TickFilter. Handed out by eachFilteredChunk().
+    class ChunkFilter
+    {
+    public:
+        bool isActive() const {return mCount != 0;}
+
+        bool passes(size_t row) const
+        {
+            for(U32 i = 0; i < mCount; ++i)
+            {
+                if(!mFilter->passes(mIDs[i], mTicks[i][row])) {return false;}
+            }
+            return true;
+        }
+
+    private:
+        friend class ArchetypeManager;
+        TickFilter const* mFilter{nullptr};
+        std::array<ComponentTicks const*, MAX_NUM_COMPONENT_TYPES> mTicks{};
+        std::array<Index_t, MAX_NUM_COMPONENT_TYPES> mIDs{};
+        U32 mCount{0};
+    };
+
+    //Calls fn(std::span<Entity const>, std::span<ComponentTs>...) once per chunk of every
+    //archetype that has all of ComponentTs and none of excluded. The spans line up row for row.
+    template <typename ...ComponentTs, typename Func>
+    void eachChunk(Func&& fn, Signature_t excluded = {})
+    {
+        Signature_t required;
+        (required.set(GetIDFromType<ComponentTs>()), ...);
+
+        for(auto const& archetype : mArchetypes)
+        {
+            if((archetype->signature & required) != required) {continue;}
+            if((archetype->signature & excluded).any()) {continue;}
+
+            for(auto& chunk : archetype->chunks)
+            {
+                fn(std::span<Entity const>{archetype->getEntities(chunk), chunk.count},
+                    std::span<ComponentTs>{archetype->template getColumn<ComponentTs>(chunk), chunk.count}...);
+            }
+        }
+    }
+
+    //Like eachChunk(), but fn is called as fn(ChunkFilter const&, std::span<Entity const>, std::span<ComponentTs>...)
+    //so it can skip the rows that dont pass filter.
+    template <typename ...ComponentTs, typename Func>
+    void eachFilteredChunk(Func&& fn, Signature_t excluded, TickFilter const& filter)
+    {
+        Signature_t required;
+        (required.set(GetIDFromType<ComponentTs>()), ...);
+
+        for(auto const& archetype : mArchetypes)
+        {
+            if((archetype->signature & required) != required) {continue;}
+            if((archetype->signature & excluded).any()) {continue;}
+
+            for(auto& chunk : archetype->chunks)
+            {
+                if(!mayPass(chunk, filter)) {continue;}
+
+                fn(makeChunkFilter(*archetype, chunk, filter),
+                    std::span<Entity const>{archetype->getEntities(chunk), chunk.count},
+                    std::span<ComponentTs>{archetype->template getColumn<ComponentTs>(chunk), chunk.count}...);
+            }
+        }
+    }
+
+    //Calls fn(Entity, ComponentTs&...) for every entity that has all of ComponentTs, none of excluded
+    //and passes filter.
+    template <typename ...ComponentTs, typename Func>
+    void each(Func&& fn, Signature_t excluded = {}, TickFilter const& filter = {})
+    {
+        if(!filter.isActive())
+        {
+            eachChunk<ComponentTs...>([&fn](std::span<Entity const> entities, std::span<ComponentTs>... columns)
+            {
+                for(size_t row = 0; row < entities.size(); ++row)
+                    fn(entities[row], columns[row]...);
+            }, excluded);
+            return;
+        }
+
+        eachFilteredChunk<ComponentTs...>([&fn](ChunkFilter const& rows,
+            std::span<Entity const> entities, std::span<ComponentTs>... columns)
+        {
+            for(size_t row = 0; row < entities.size(); ++row)
+            {
+                if(rows.passes(row)) {fn(entities[row], columns[row]...);}
+            }
+        }, excluded, filter);
+    }
+
+    auto getArchetypeCount() const {return mArchetypes.size();}
+
+    //A position in the rows of all archetypes. Used by view iterators.
+    struct Cursor
+    {
+        U32 archetype{0};
+        U32 chunk{0};
+        U32 row{0};
+        bool operator==(Cursor const&) const=default;
+    };
+
+    Cursor endCursor() const {return {static_cast<U32>(mArchetypes.size()), 0, 0};}
+
+    //Move cursor forward to the first row at or after it that belongs to an archetype
+    //with all of required and none of excluded. Leaves it at endCursor() if there isnt one.
+    void seek(Cursor& cursor, Signature_t required, Signature_t excluded) const;
+
+    Entity getEntity(Cursor const& cursor) const
+    {
+        auto const& archetype {*mArchetypes[cursor.archetype]};
+        return archetype.getEntities(archetype.chunks[cursor.chunk])[cursor.row];
+    }
+
+    template <typename ComponentT>
+    ComponentT& getComponent(Cursor const& cursor)
+    {
+        auto const& archetype {*mArchetypes[cursor.archetype]};
+        return archetype.template getColumn<ComponentT>(archetype.chunks[cursor.chunk])[cursor.row];
+    }
+
+    bool passes(Cursor const& cursor, TickFilter const& filter) const
+    {
+        auto const& archetype {*mArchetypes[cursor.archetype]};
+        return makeChunkFilter(archetype, archetype.chunks[cursor.chunk], filter).passes(cursor.row);
+    }
+
+    //False if no row of the cursor's chunk can pass filter, in which case skipChunk()
+    //moves the cursor past the chunk (seek() then carries on from the next one).
+    bool chunkMayPass(Cursor const& cursor, TickFilter const& filter)
+    {
+        return mayPass(mArchetypes[cursor.archetype]->chunks[cursor.chunk], filter);
+    }
+
+    void skipChunk(Cursor& cursor) const
+    {
+        cursor.row = mArchetypes[cursor.archetype]->chunks[cursor.chunk].count;
+    }
+
+private:
+
+    inline constexpr static U32 sNoArchetype{~U32{0}};
+    inline constexpr static U32 sNoColumn{~U32{0}};
+
+    struct ChunkDeleter
+    {
+        void operator()(std::byte* mem) const
+        {
+            ::operator delete[](mem, std::align_val_t{sChunkAlignment});
+        }
+    };
+
+    struct Chunk
+    {
+        std::unique_ptr<std::byte[], ChunkDeleter> memory;
+
+        //How many rows are in use.
+        U32 count{0};
+
+        //The newest ticks of each component column, so that filtered queries can skip chunks
+        //where nothing was added or changed. Only ever raised, so moving the newest row out just
+        //leaves it conservative. markChanged() can run on many threads, so it goes through atomic_ref.
+        std::array<ComponentTicks, MAX_NUM_COMPONENT_TYPES> newestTicks{};
+
+        void raiseNewestTicks(Index_t componentID, ComponentTicks const& ticks)
+        {
+            auto& newest {newestTicks[componentID]};
+            newest.added = std::max(newest.added, ticks.added);
+            newest.changed = std::max(newest.changed, ticks.changed);
+        }
+    };
+
+    static bool mayPass(Chunk& chunk, TickFilter const& filter)
+    {
+        auto const filtered {filter.added | filter.changed};
+        for(Index_t id = 0; id < MAX_NUM_COMPONENT_TYPES; ++id)
+        {
+            if(!filtered.test(id)) {continue;}
+
+            auto& newest {chunk.newestTicks[id]};
+            ComponentTicks const ticks {std::atomic_ref{newest.added}.load(std::memory_order_relaxed),
+                std::atomic_ref{newest.changed}.load(std::memory_order_relaxed)};
+            if(!filter.passes(id, ticks)) {return false;}
+        }
+        return true;
+    }
+
+    struct Archetype
+    {
+        Signature_t signature{};
+
+        //How many entities fit in one chunk of this archetype.
+        U32 rowsPerChunk{0};
+
+        //Byte offset of each component's column from the start of a chunk,
+        //or sNoColumn if the component isnt part of this archetype.
+        std::array<U32, MAX_NUM_COMPONENT_TYPES> columnOffsets{};
+
+        //Same for each component's ComponentTicks column.
+        std::array<U32, MAX_NUM_COMPONENT_TYPES> tickOffsets{};
+
+        //Every chunk is full except possibly the last one.
+        std::vector<Chunk> chunks;
+
+        Entity* getEntities(Chunk const& chunk) const
+        {
+            return reinterpret_cast<Entity*>(chunk.memory.get());
+        }
+
+        std::byte* getColumn(Chunk const& chunk, Index_t componentID) const
+        {
+            return chunk.memory.get() + columnOffsets[componentID];
+        }
+
+        template <typename ComponentT>
+        ComponentT* getColumn(Chunk const& chunk) const
+        {
+            return reinterpret_cast<ComponentT*>(getColumn(chunk, GetIDFromType<ComponentT>()));
+        }
+
+        ComponentTicks* getTicks(Chunk const& chunk, Index_t componentID) const
+        {
+            return reinterpret_cast<ComponentTicks*>(chunk.memory.get() + tickOffsets[componentID]);
+        }
+    };
+
+    //Where an entity's components are stored.
+    struct Location
+    {
+        U32 archetype{sNoArchetype};
+        U32 chunk{0};
+        U32 row{0};
+    };
+
+    std::vector<std::unique_ptr<Archetype>> mArchetypes;
+
+    //Signature (as an integer) to index into mArchetypes.
+    std::unordered_map<U64, U32> mArchetypeLookup;
+
+    //Indexed by entity index.
+    ChunkedArray<Location> mLocations;
+
+    Signature_t getSignature(Entity const& entity) const;
+    void* getComponentImpl(Entity const& entity, Index_t componentID);
+    ComponentTicks* getTicksImpl(Entity const& entity, Index_t componentID);
+
+    static ChunkFilter makeChunkFilter(Archetype const& archetype, Chunk const& chunk, TickFilter const& filter)
+    {
+        ChunkFilter rows;
+        rows.mFilter = &filter;
+
+        auto const filtered {filter.added | filter.changed};
+        for(Index_t id = 0; id < MAX_NUM_COMPONENT_TYPES; ++id)
+        {
+            if(!filtered.test(id)) {continue;}
+            rows.mTicks[rows.mCount] = archetype.getTicks(chunk, id);
+            rows.mIDs[rows.mCount++] = id;
+        }
+
+        return rows;
+    }
+
+    //Move the entity into the archetype for newSignature, copying the components (and their ticks)
+    //both archetypes share and default constructing the ones that are new. New components are stamped
+    //with tick, so it only matters when components are being added.
+    void changeSignature(Entity const& entity, Signature_t newSignature, U32 tick = 0);
+
+    U32 getOrCreateArchetype(Signature_t signature);
+
+    //Append a row for entity to the end of the archetype and return where it went.
+    Location pushRow(U32 archetypeIdx, Entity const& entity);
+
+    //Fill the hole with the archetype's last row and patch the moved entity's location.
+    void eraseRow(Location const& location);
+};
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "ComponentID.hpp"
+#include "HelpfulTypeAliases.hpp"
+
+namespace DF
+{
+
+//Every component remembers the ECS change tick it was added at and the tick it was last
+//marked as changed at (see ECS::advanceChangeTick() and ECS::markChanged()).
+//A reactive system keeps the tick it last ran at, and only looks at components whose
+//ticks are newer, instead of re-processing everything every frame.
+struct ComponentTicks
+{
+    U32 added{0};
+    U32 changed{0};
+};
+
+//Narrows a view down to the entities whose components in added/changed
+//have been added/changed after sinceTick.
+struct TickFilter
+{
+    Signature_t added{};
+    Signature_t changed{};
+    U32 sinceTick{0};
+
+    bool isActive() const {return added.any() || changed.any();}
+
+    bool passes(Index_t componentID, ComponentTicks const& ticks) const
+    {
+        return (!added.test(componentID) || ticks.added > sinceTick) &&
+            (!changed.test(componentID) || ticks.changed > sinceTick);
+    }
+};
+
+}
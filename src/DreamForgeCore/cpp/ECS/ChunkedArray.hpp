@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <span>
+#include <bit>
+#include <algorithm>
+#include "HelpfulTypeAliases.hpp"
+
+namespace DF
+{
+
+//A growable array made of fixed size chunks. Growing only allocates new chunks,
+//so elements never move and pointers/references to them stay valid for the life
+//of the array (unlike std::vector). Indexing is a shift and a mask.
+//Each chunk is contiguous, so hot loops should walk it one chunk at a time.
+template <typename T, size_t ChunkSize = 4096>
+class ChunkedArray
+{
+    static_assert(std::has_single_bit(ChunkSize), "ChunkSize must be a power of two");
+
+public:
+    ChunkedArray()=default;
+    ~ChunkedArray()=default;
+
+    ChunkedArray(ChunkedArray const&)=delete;
+    ChunkedArray& operator=(ChunkedArray const&)=delete;
+    ChunkedArray(ChunkedArray&&) noexcept=default;
+    ChunkedArray& operator=(ChunkedArray&&) noexcept=default;
+
+    inline static constexpr size_t sChunkSize{ChunkSize};
+
+    T& operator[](size_t idx) {return mChunks[idx >> sShift][idx & sMask];}
+    T const& operator[](size_t idx) const {return mChunks[idx >> sShift][idx & sMask];}
+
+    size_t getCapacity() const {return mChunks.size() * ChunkSize;}
+    size_t getChunkCount() const {return mChunks.size();}
+
+    //Allocate chunks until at least minCapacity elements fit. Never shrinks.
+    void reserve(size_t minCapacity)
+    {
+        while(getCapacity() < minCapacity)
+            mChunks.push_back(std::make_unique<T[]>(ChunkSize));
+    }
+
+    //The part of chunk chunkIdx that lies below size (the number of elements in use).
+    std::span<T> getChunk(size_t chunkIdx, size_t size)
+    {
+        auto const begin {chunkIdx * ChunkSize};
+        auto const count {size > begin ? std::min(size - begin, ChunkSize) : 0};
+        return {mChunks[chunkIdx].get(), count};
+    }
+
+    std::span<T const> getChunk(size_t chunkIdx, size_t size) const
+    {
+        auto const begin {chunkIdx * ChunkSize};
+        auto const count {size > begin ? std::min(size - begin, ChunkSize) : 0};
+        return {mChunks[chunkIdx].get(), count};
+    }
+
+private:
+    inline static constexpr size_t sShift{std::countr_zero(ChunkSize)};
+    inline static constexpr size_t sMask{ChunkSize - 1};
+
+    std::vector<std::unique_ptr<T[]>> mChunks;
+};
+
+}
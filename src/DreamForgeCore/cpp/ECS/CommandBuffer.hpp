@@ -0,0 +1,136 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include "EntityManager.hpp"
+#include "Components.hpp"
+
+namespace DF
+{
+
+//Records structural changes (create/destroy entities, add/remove components) so they can
+//be applied later in one batch by ECS::flushCommands(), instead of mutating storage in the
+//middle of an iteration or from a worker thread. Every thread gets its own buffer through
+//ECS::getCommandBuffer(), so recording never takes a lock.
+class CommandBuffer
+{
+public:
+
+    enum struct CommandType : U8
+    {
+        CREATE_ENTITY,
+        DESTROY_ENTITY,
+        ADD_COMPONENT,
+        REMOVE_COMPONENT
+    };
+
+    struct Command
+    {
+        CommandType type;
+        U32 componentID{0};
+        Entity entity{};
+
+        //Where an ADD_COMPONENT command's value starts in the payload.
+        U32 payloadOffset{0};
+    };
+
+    //owner is the ThreadPool thread index the buffer belongs to. It is baked into
+    //the pending handles so they cant be used with another thread's buffer.
+    explicit CommandBuffer(U32 owner = 0) : mOwner{owner} {}
+    ~CommandBuffer()=default;
+
+    CommandBuffer(CommandBuffer const&)=delete;
+    CommandBuffer& operator=(CommandBuffer const&)=delete;
+    CommandBuffer(CommandBuffer&&) noexcept=default;
+    CommandBuffer& operator=(CommandBuffer&&) noexcept=default;
+
+    //The returned handle is a placeholder that only means something to commands recorded
+    //into this same buffer. It becomes a real entity when the buffer is flushed.
+    //Commands that use it from another thread's buffer are dropped.
+    [[nodiscard]] Entity createEntity()
+    {
+        //Pending handles have generation 0 like null handles, so start
+        //at slot 1 to keep a null handle from looking like a pending one.
+        Entity const pending {mOwner << sPendingSlotBits | ++mPendingEntityCount, 0};
+        mCommands.push_back({.type = CommandType::CREATE_ENTITY, .entity = pending});
+        return pending;
+    }
+
+    void destroyEntity(Entity const& entity)
+    {
+        mCommands.push_back({.type = CommandType::DESTROY_ENTITY, .entity = entity});
+    }
+
+    //Overwrites the component if the entity already has one when the command is applied. That
+    //counts as a change (like ECS::setComponentByID()), so no added or removed events are sent.
+    template <typename ComponentT>
+    void addComponent(Entity const& entity, ComponentT const& value = {})
+    {
+        static_assert(std::is_trivially_copyable_v<ComponentT>, "component values are stored as raw bytes");
+        static_assert(alignof(ComponentT) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+
+        //Keep the value aligned so it can be read in place when the buffer is applied.
+        auto const offset {(mPayload.size() + alignof(ComponentT) - 1) & ~(alignof(ComponentT) - 1)};
+        mPayload.resize(offset + sizeof(ComponentT));
+        std::memcpy(mPayload.data() + offset, &value, sizeof(ComponentT));
+
+        mCommands.push_back({
+            .type = CommandType::ADD_COMPONENT,
+            .componentID = static_cast<U32>(GetIDFromType<ComponentT>()),
+            .entity = entity,
+            .payloadOffset = static_cast<U32>(offset)
+        });
+    }
+
+    template <typename ...ComponentTs>
+    void removeComponents(Entity const& entity)
+    {
+        (mCommands.push_back({
+            .type = CommandType::REMOVE_COMPONENT,
+            .componentID = static_cast<U32>(GetIDFromType<ComponentTs>()),
+            .entity = entity
+        }), ...);
+    }
+
+    static bool isPending(Entity const& entity)
+    {
+        return entity.getGeneration() == 0 && entity.getIndex() != 0;
+    }
+
+    //Which of this buffer's createEntity() calls made a pending handle, starting at 1.
+    //0 if the handle was made by another buffer.
+    U32 getPendingSlot(Entity const& pending) const
+    {
+        auto const slot {pending.getIndex() & sPendingSlotMask};
+        bool const isOurs {pending.getIndex() >> sPendingSlotBits == mOwner && slot <= mPendingEntityCount};
+        return isOurs ? slot : 0;
+    }
+
+    bool isEmpty() const {return mCommands.empty();}
+    auto getPendingEntityCount() const {return mPendingEntityCount;}
+    std::span<Command const> getCommands() const {return mCommands;}
+    void const* getPayload(U32 offset) const {return mPayload.data() + offset;}
+
+    //Keeps the allocations around for the next frame.
+    void clear()
+    {
+        mCommands.clear();
+        mPayload.clear();
+        mPendingEntityCount = 0;
+    }
+
+private:
+    //The low bits of a pending handle's index count up per buffer and the high bits are the owner,
+    //so a buffer can make about 16 million pending entities between flushes.
+    inline constexpr static U32 sPendingSlotBits{24};
+    inline constexpr static U32 sPendingSlotMask{(1u << sPendingSlotBits) - 1};
+
+    std::vector<Command> mCommands;
+    std::vector<std::byte> mPayload;
+    U32 mPendingEntityCount{0};
+    U32 mOwner{0};
+};
+
+}
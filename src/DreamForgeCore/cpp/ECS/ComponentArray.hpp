@@ -0,0 +1,411 @@
+#pragma once
+#include "Entity.hpp"
+#include "ChunkedArray.hpp"
+#include "ChangeTracking.hpp"
+#include "Logging.hpp"
+#include "errorHandling.hpp"
+#include <vector>
+#include <span>
+#include <memory>
+#include <utility>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace DF
+{
+
+//The type erased part of a ComponentArray, for the code paths that only know a component
+//type by its ID (removing every component of an entity, replaying recorded commands).
+//Everything that knows the type casts to the ComponentArray instead, so the typed paths
+//never go through a virtual call.
+class ComponentPool
+{
+public:
+    virtual ~ComponentPool()=default;
+
+    virtual size_t getSize() const=0;
+    virtual void reserve(size_t count)=0;
+    [[nodiscard]] virtual bool contains(Entity const& entity) const=0;
+    virtual void erase(Entity const& entity)=0;
+    [[nodiscard]] virtual NonOwningPtr<ComponentTicks const> getTicks(Entity const& entity) const=0;
+
+    //Stamp the entity's component as changed at tick. Returns false if it was already
+    //stamped with tick or the entity doesnt have a component in the pool.
+    virtual bool markChanged(Entity const& entity, U32 tick)=0;
+
+    //Returns nullptr if the entity doesnt have a component in the pool.
+    [[nodiscard]] virtual void* getRawComponent(Entity const& entity)=0;
+
+    //value points to the component type the pool stores.
+    virtual void insertCopy(void const* value, Entity const& entity, U32 tick)=0;
+
+    //Bulk access to the dense arrays for snapshots (see ECSSnapshot.cpp).
+    //Chunk i of the entities lines up with chunk i of the raw component bytes.
+    virtual size_t getChunkCount() const=0;
+    virtual std::span<Entity const> getEntityChunk(size_t chunkIdx) const=0;
+    virtual void const* getRawComponentChunk(size_t chunkIdx) const=0;
+
+    //Append entities.size() components copied from the packed array at components,
+    //all stamped as added at tick. None of the entities can already be in the pool.
+    virtual void insertRaw(std::span<Entity const> entities, void const* components, U32 tick)=0;
+
+    //The dense arrays are split into blocks of this many components, and each block
+    //remembers the newest ticks of anything in it (see getBlockTicks()). Filtered views
+    //skip the blocks where nothing was added or changed, instead of testing every component.
+    inline constexpr static size_t sTickBlockSize{256};
+};
+
+//The storage ComponentManager keeps each component type in.
+//It is a sparse set: the components and the handles of the entities that own them are
+//packed into two parallel dense arrays, and a paged sparse array indexed by entity index
+//maps back into the dense arrays. Lookups are two array indexes and iterating
+//is a linear walk over m_array one chunk at a time. The dense arrays grow in chunks,
+//so a component never moves in memory unless erase() swaps it into a hole.
+template <class ComponentT> class ComponentArray final : public ComponentPool
+{
+public:
+
+    ComponentArray()=default;
+    ~ComponentArray() override=default;
+
+    ComponentArray(ComponentArray const&)=delete;
+    ComponentArray(ComponentArray&&)=delete;
+    ComponentArray& operator=(ComponentArray const&)=delete;
+    ComponentArray& operator=(ComponentArray&&)=delete;
+
+    size_t getSize() const override {return mSize;}
+    inline auto getCapacity() const {return m_array.getCapacity();}
+    void reserve(size_t count) override
+    {
+        m_array.reserve(count);
+        mDenseEntities.reserve(count);
+        mTicks.reserve(count);
+        mBlockTicks.resize(m_array.getCapacity() / sTickBlockSize);
+    }
+
+    [[nodiscard]] bool contains(Entity const& entity) const override;
+    [[nodiscard]] NonOwningPtr<ComponentT> getComponent(Entity const& entity);
+    void insert(ComponentT const&, Entity const&, U32 tick);
+    void erase(Entity const&) override;
+
+    [[nodiscard]] void* getRawComponent(Entity const& entity) override
+    {
+        auto const idx {denseIdxOf(entity)};
+        return idx == sNullIdx ? nullptr : &m_array[idx];
+    }
+
+    void insertCopy(void const* value, Entity const& entity, U32 tick) override
+    {
+        insert(*static_cast<ComponentT const*>(value), entity, tick);
+    }
+
+    //None of my component types can benefit from a move,
+    //but I will put this here in case that changes.
+    void insert(ComponentT&&, Entity const&, U32 tick);
+
+    //Construct a ComponentType in the array instead of
+    //copying/moving from an already existing ComponentType into the array.
+    template<class ...Args>
+    void emplace(Entity const&, U32 tick, Args&& ...ctorArgs);
+
+    [[nodiscard]] NonOwningPtr<ComponentTicks const> getTicks(Entity const& entity) const override
+    {
+        auto const idx {denseIdxOf(entity)};
+        return idx == sNullIdx ? nullptr : &mTicks[idx];
+    }
+
+    bool markChanged(Entity const& entity, U32 tick) override
+    {
+        auto const idx {denseIdxOf(entity)};
+        if(idx == sNullIdx || mTicks[idx].changed == tick) {return false;}
+
+        mTicks[idx].changed = tick;
+
+        //Systems running in parallel can mark different components of the same block,
+        //but tick is the newest there is, so they all store the same thing.
+        std::atomic_ref{mBlockTicks[idx / sTickBlockSize].changed}.store(tick, std::memory_order_relaxed);
+        return true;
+    }
+
+    //The newest added and changed ticks of the components in block blockIdx (dense indices
+    //blockIdx * sTickBlockSize and up). Can be read while systems call markChanged().
+    ComponentTicks getBlockTicks(size_t blockIdx)
+    {
+        auto& block {mBlockTicks[blockIdx]};
+        return {std::atomic_ref{block.added}.load(std::memory_order_relaxed),
+            std::atomic_ref{block.changed}.load(std::memory_order_relaxed)};
+    }
+
+    //The packed components and their owners. Index i of one lines up with index i of the other.
+    ComponentT& componentAt(size_t denseIdx) {return m_array[denseIdx];}
+    Entity const& entityAt(size_t denseIdx) const {return mDenseEntities[denseIdx];}
+    ComponentTicks const& ticksAt(size_t denseIdx) const {return mTicks[denseIdx];}
+
+    //The caller guarantees the entity has a ComponentT (i.e. its signature was checked).
+    ComponentT& getComponentUnchecked(Entity const& entity)
+    {
+        return m_array[mSparsePages[entity.getIndex() / sSparsePageSize][entity.getIndex() % sSparsePageSize]];
+    }
+
+    ComponentTicks const& getTicksUnchecked(Entity const& entity) const
+    {
+        return mTicks[mSparsePages[entity.getIndex() / sSparsePageSize][entity.getIndex() % sSparsePageSize]];
+    }
+
+    ChunkedArray<Entity> const& getEntityArray() const {return mDenseEntities;}
+
+    //The same, but a chunk at a time for linear iteration.
+    size_t getChunkCount() const override {return m_array.getChunkCount();}
+    std::span<ComponentT> getComponentChunk(size_t chunkIdx) {return m_array.getChunk(chunkIdx, mSize);}
+    std::span<Entity const> getEntityChunk(size_t chunkIdx) const override {return mDenseEntities.getChunk(chunkIdx, mSize);}
+    void const* getRawComponentChunk(size_t chunkIdx) const override {return m_array.getChunk(chunkIdx, mSize).data();}
+
+    void insertRaw(std::span<Entity const> entities, void const* components, U32 tick) override;
+
+private:
+
+    //Number of sparse indices per page. Pages are only allocated once
+    //an entity index that falls inside of them gets a component.
+    inline constexpr static size_t sSparsePageSize{4096};
+    inline constexpr static U32 sNullIdx{~U32{0}};
+
+    //How many components are currently being stored
+    size_t mSize{0};
+
+    ChunkedArray<ComponentT> m_array;
+    ChunkedArray<Entity> mDenseEntities;
+
+    //When each component was added and last changed. Lines up with m_array.
+    ChunkedArray<ComponentTicks> mTicks;
+
+    //The newest of mTicks in each block. Only ever raised, so a block that
+    //had its newest component erased or swapped out just stays conservative.
+    std::vector<ComponentTicks> mBlockTicks;
+
+    static_assert(ChunkedArray<ComponentT>::sChunkSize % sTickBlockSize == 0,
+        "a tick block cant straddle two chunks of the dense arrays");
+
+    void raiseBlockTicks(size_t denseIdx, ComponentTicks const& ticks)
+    {
+        auto& block {mBlockTicks[denseIdx / sTickBlockSize]};
+        block.added = std::max(block.added, ticks.added);
+        block.changed = std::max(block.changed, ticks.changed);
+    }
+
+    std::vector<std::unique_ptr<U32[]>> mSparsePages;
+
+    //Returns sNullIdx if the entity doesnt have a component in this array.
+    U32 denseIdxOf(Entity const&) const;
+
+    //Get the sparse slot for an entity index, allocating its page if needed.
+    U32& sparseSlotOf(U32 entityIdx);
+
+    //Helper method to reduce code repetition. Called in debug builds only.
+    bool insertDataCheck(Entity const&) const;
+
+    //Another helper method to reduce code repitition. Called in
+    //copy/move insert and emplace to grow the dense arrays if they are full.
+    void growIfFull() {if(mSize == getCapacity()) {reserve(mSize + 1);}}
+
+    //Another helper method to reduce code repitition.
+    //Called in copy/move insert and emplace after the insertion happened.
+    void updateSparseOnInsert(Entity const&, U32 tick);
+
+};
+
+template<class ComponentT>
+U32 ComponentArray<ComponentT>::denseIdxOf(Entity const& entity) const
+{
+    auto const page {entity.getIndex() / sSparsePageSize};
+
+    if(page >= mSparsePages.size() || !mSparsePages[page])
+        return sNullIdx;
+
+    auto const idx {mSparsePages[page][entity.getIndex() % sSparsePageSize]};
+
+    //The sparse array is keyed by index only, so compare the whole
+    //handle to reject stale entities whose slot has been recycled.
+    if(idx == sNullIdx || mDenseEntities[idx] != entity)
+        return sNullIdx;
+
+    return idx;
+}
+
+template<class ComponentT>
+U32& ComponentArray<ComponentT>::sparseSlotOf(U32 entityIdx)
+{
+    auto const page {entityIdx / sSparsePageSize};
+
+    if(page >= mSparsePages.size())
+        mSparsePages.resize(page + 1);
+
+    if(!mSparsePages[page])
+    {
+        mSparsePages[page] = std::make_unique_for_overwrite<U32[]>(sSparsePageSize);
+        std::fill_n(mSparsePages[page].get(), sSparsePageSize, sNullIdx);
+    }
+
+    return mSparsePages[page][entityIdx % sSparsePageSize];
+}
+
+template<class ComponentT>
+bool ComponentArray<ComponentT>::contains(Entity const& entity) const
+{
+    return denseIdxOf(entity) != sNullIdx;
+}
+
+template<class ComponentT> template<class ...Args>
+void ComponentArray<ComponentT>::emplace(
+    Entity const& entity, U32 tick, Args&& ...ctorArgs)
+{
+#ifdef DF_DEBUG
+    if(!insertDataCheck(entity)) {return;}
+#endif
+
+    //Since the destructors are trivial for component types, I don't think I need to
+    //destruct them before calling placement new (they dont do anything...)
+    //I am going to do it anyway just in case, to appease the abstract machine gods.
+    growIfFull();
+    auto pos = &m_array[mSize];
+    pos->~ComponentT();
+    ::new(pos) ComponentT(std::forward<Args>(ctorArgs)...);
+    updateSparseOnInsert(entity, tick);
+    ++mSize;
+}
+
+//None of my component types can benefit from a move,
+//but I will put this here in case that changes later
+template <class ComponentT>
+void ComponentArray<ComponentT>::insert(ComponentT&& toInsert,
+    Entity const& entity, U32 tick)
+{
+#ifdef DF_DEBUG
+    if(!insertDataCheck(entity)) {return;}
+#endif
+    growIfFull();
+    m_array[mSize] = std::move(toInsert);
+    updateSparseOnInsert(entity, tick);
+    ++mSize;
+}
+
+template<class ComponentT>
+void ComponentArray<ComponentT>::insert(ComponentT const& toInsert,
+    Entity const& entity, U32 tick)
+{
+#ifdef DF_DEBUG
+    if(!insertDataCheck(entity)) {return;}
+#endif
+    growIfFull();
+    m_array[mSize] = toInsert;
+    updateSparseOnInsert(entity, tick);
+    ++mSize;
+}
+
+template<class ComponentT>
+void ComponentArray<ComponentT>::insertRaw(std::span<Entity const> entities, void const* components, U32 tick)
+{
+    auto const* src {static_cast<ComponentT const*>(components)};
+    auto const count {entities.size()};
+    reserve(mSize + count);
+
+    //Copy in runs that end at chunk boundaries, since only the inside of a chunk is contiguous.
+    constexpr auto chunkSize {ChunkedArray<ComponentT>::sChunkSize};
+    for(size_t done = 0; done < count;)
+    {
+        auto const dst {mSize + done};
+        auto const run {std::min(count - done, chunkSize - dst % chunkSize)};
+        std::memcpy(&m_array[dst], src + done, run * sizeof(ComponentT));
+        std::memcpy(&mDenseEntities[dst], entities.data() + done, run * sizeof(Entity));
+        done += run;
+    }
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        mTicks[mSize + i] = {.added = tick, .changed = tick};
+        raiseBlockTicks(mSize + i, mTicks[mSize + i]);
+        sparseSlotOf(entities[i].getIndex()) = static_cast<U32>(mSize + i);
+    }
+
+    mSize += count;
+}
+
+//Helper method to reduce code repetition. Called in debug builds only.
+template<class ComponentT>
+bool ComponentArray<ComponentT>::insertDataCheck(Entity const& entity) const
+{
+    if(contains(entity))
+    {
+        Logger::get().stdoutError("attempted to add a component"
+            "to an entity more than once");
+        return false;
+    }
+
+    return true;
+}
+
+//Another helper method to reduce code repitition.
+//Called in copy/move insert and emplace after the component was written to m_array[mSize].
+template<class ComponentT>
+void ComponentArray<ComponentT>::updateSparseOnInsert(Entity const& entity, U32 tick)
+{
+    mDenseEntities[mSize] = entity;
+    mTicks[mSize] = {.added = tick, .changed = tick};
+    raiseBlockTicks(mSize, mTicks[mSize]);
+    sparseSlotOf(entity.getIndex()) = static_cast<U32>(mSize);
+}
+
+template<class ComponentT>
+void ComponentArray<ComponentT>::erase(Entity const& entity)
+{
+#ifdef DF_DEBUG
+    if(mSize == 0)
+    {
+        Logger::get().stdoutError("trying to call "
+            "ComponentArray::erase() from an empty component array");
+        return;
+    }
+
+    if(!contains(entity))
+    {
+        Logger::get().stdoutError("invalid entity supplied to "
+            "ComponentArray::erase()");
+        return;
+    }
+#endif
+    //The ordering of the components doesnt matter, so I will
+    //just copy the last element to fill the component we are erasing.
+    //None of the components benifit from a move, so just copy.
+    auto const lastIdx {mSize - 1};
+    auto& removedSlot {sparseSlotOf(entity.getIndex())};
+    auto const idxToRemove {removedSlot};
+
+    m_array[idxToRemove] = m_array[lastIdx];
+    mTicks[idxToRemove] = mTicks[lastIdx];
+    raiseBlockTicks(idxToRemove, mTicks[idxToRemove]);
+
+    auto const lastEntity {mDenseEntities[lastIdx]};
+    mDenseEntities[idxToRemove] = lastEntity;
+    sparseSlotOf(lastEntity.getIndex()) = idxToRemove;
+
+    //Must come after the last entities slot was patched in case the erased entity was the last one.
+    removedSlot = sNullIdx;
+
+    --mSize;
+}
+
+template <typename ComponentT> [[nodiscard]]
+NonOwningPtr<ComponentT> ComponentArray<ComponentT>::getComponent(Entity const& entity)
+{
+    auto const idx {denseIdxOf(entity)};
+#ifdef DF_DEBUG
+    if(idx == sNullIdx)
+    {
+        Logger::get().stdoutError("requesting a component from ComponentArray"
+            "<ComponentT>::getComponent() with an entity that doesnt have this component");
+    }
+#endif
+    return idx == sNullIdx ? nullptr : &m_array[idx];
+}
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <bitset>
+#include "HelpfulTypeAliases.hpp"
+
+namespace DF
+{
+
+//Component IDs are dense, handed out by the ComponentRegistry from 0 up to this.
+inline constexpr Index_t MAX_NUM_COMPONENT_TYPES {64};
+
+//Bit i is set when the entity has the component with ID i.
+using Signature_t = std::bitset<MAX_NUM_COMPONENT_TYPES>;
+
+}
@@ -1,21 +1,29 @@
 #pragma once
 #include "Components.hpp"
 #include "EntityManager.hpp"
-#include <variant>
+#include "ComponentRegistry.hpp"
+#include "ComponentArray.hpp"
+#include "ChangeTracking.hpp"
 #include <array>
-#include <cassert>
 #include <memory>
-#include <unordered_map>
+#include <mutex>
+#include <atomic>
 
 namespace DF
 {
 
+template <typename IncludeList, typename ExcludeList> class View;
+
 //component manager
+//Keeps one ComponentArray per component ID. The arrays are made the first time their
+//component type is used, so types registered after the ECS was made work the same way.
+//Systems running in parallel can be the first to use a type (just making a view uses it),
+//so making an array takes a lock. Looking one up is an atomic load.
 class ComponentManager
 {
 public:
 
-    ComponentManager();
+    ComponentManager()=default;
     ~ComponentManager()=default;
 
     ComponentManager(ComponentManager const&)=delete;
@@ -23,76 +31,123 @@ public:
     ComponentManager& operator=(ComponentManager const&)=delete;
     ComponentManager& operator=(ComponentManager&&)=delete;
 
+    //tick is the ECS change tick the new components are stamped with.
     template <typename ...ComponentTs>
-    void insertComponents(Entity const& entity)
+    void insertComponents(Entity const& entity, U32 tick)
     {
-        (mComponentArrays[GetIDFromType<ComponentTs>].emplace(entity), ...);
+        (getArray<ComponentTs>().emplace(entity, tick), ...);
     }
 
     template <typename ...ComponentTs>
     void removeComponents(Entity const& entity)
     {
-        (mComponentArrays[GetIDFromType<ComponentTs>].erase(entity), ...);
+        (getArray<ComponentTs>().erase(entity), ...);
+    }
+
+    //Remove every component the entity owns from every component array.
+    void removeAllComponents(Entity const& entity)
+    {
+        for(Index_t id = 0; id < mPools.size(); ++id)
+        {
+            if(auto* pool {peekPool(id)}; pool && pool->contains(entity)) {pool->erase(entity);}
+        }
+    }
+
+    //Make room for at least count of each ComponentTs without further allocation.
+    template <typename ...ComponentTs>
+    void reserve(size_t count)
+    {
+        (getArray<ComponentTs>().reserve(count), ...);
+    }
+
+    //Only reserves in the arrays that have been made so far.
+    void reserveAll(size_t count)
+    {
+        for(Index_t id = 0; id < mPools.size(); ++id)
+        {
+            if(auto* pool {peekPool(id)}; pool) {pool->reserve(count);}
+        }
+    }
+
+    template <typename ComponentT>
+    [[nodiscard]] NonOwningPtr<ComponentT> getComponent(Entity const& entity)
+    {
+        return getArray<ComponentT>().getComponent(entity);
     }
-    
-private:
 
-    //Component array implementation only used by the enclosing 
-    //component manager class (not resizeable)
-    template <class ComponentT> class ArrayImpl
+    //Runtime versions of insertComponents and removeComponents for when the type is only
+    //known by ID (e.g. replaying recorded commands). value points to a componentID type to copy in.
+    void insertComponentByID(Entity const& entity, Index_t componentID, void const* value, U32 tick)
     {
-    public:
-        ArrayImpl()=default;
-        ~ArrayImpl()=default;
+        getPool(componentID).insertCopy(value, entity, tick);
+    }
 
-        ArrayImpl(ArrayImpl const&)=delete;
-        ArrayImpl& operator=(ArrayImpl const&)=delete;
-        ArrayImpl(ArrayImpl&&)noexcept;
-        ArrayImpl& operator=(ArrayImpl&&)noexcept;
+    void removeComponentByID(Entity const& entity, Index_t componentID)
+    {
+        getPool(componentID).erase(entity);
+    }
 
-        inline constexpr auto getSize() const {return mSize;}
-        inline constexpr auto getCapacity() const {return m_array.size();}
-        [[nodiscard]] NonOwningPtr<Entity> getComponent(Entity const& entity) const;
-        void insert(ComponentT const&, Entity const&);
-        void erase(Entity const&);
+    template <typename ComponentT>
+    [[nodiscard]] bool hasComponent(Entity const& entity) const
+    {
+        auto const* pool {peekPool(GetIDFromType<ComponentT>())};
+        return pool && pool->contains(entity);
+    }
 
-        //None of my component types can benefit from a move,
-        //but I will put this here in case that changes.
-        void insert(ComponentT&&, Entity const&);
+    //Returns nullptr if the entity doesnt have a ComponentT.
+    template <typename ComponentT>
+    [[nodiscard]] NonOwningPtr<ComponentTicks const> getTicks(Entity const& entity)
+    {
+        return getArray<ComponentT>().getTicks(entity);
+    }
 
-        //Construct a ComponentType in the array instead of 
-        //copying/moving from an already existing ComponentType into the array.
-        template<class ...Args> 
-        void emplace(Entity const&, Args&& ...ctorArgs);
+    //Returns false if the entity doesnt have a ComponentT or it was already marked at tick.
+    template <typename ComponentT>
+    bool markChanged(Entity const& entity, U32 tick)
+    {
+        return getArray<ComponentT>().markChanged(entity, tick);
+    }
 
-    private:
-        std::unique_ptr<ComponentT[]> m_array{nullptr};
+    //The pool of a component type only known by ID. Made if it doesnt exist yet.
+    ComponentPool& getPool(Index_t componentID)
+    {
+        if(auto* pool {peekPool(componentID)}; pool)
+            return *pool;
 
-        //How many components are currently being stored
-        size_t mSize{0};
+        std::scoped_lock lock {mMakePoolMutex};
 
-        size_t mCapacity{EntityManager::getMaxEntityCount()};
+        //Another thread may have made it while this one waited for the lock.
+        auto& owned {mOwnedPools[componentID]};
+        if(!owned)
+        {
+            owned = ComponentRegistry::get().getInfo(componentID).makePool();
+            mPools[componentID].store(owned.get(), std::memory_order_release);
+        }
 
-        //TODO change from const Entity* to reference_wrapper
-        std::unordered_map<const Entity*, Index_t> mEntityToIdxMap;
-        std::unordered_map<Index_t, const Entity*> mIdxToEntityMap;
+        return *owned;
+    }
 
-        //Helper method to reduce code repetition. Called in debug builds only.
-        bool insertDataCheck(Entity const&);
+    //Returns nullptr if nothing has used componentID yet, instead of making the pool.
+    NonOwningPtr<ComponentPool> findPool(Index_t componentID) {return peekPool(componentID);}
 
-        //Another helper method to reduce code repitition. 
-        //Called in copy/move insert and emplace.
-        void updateMapsOnInsert(Entity const&, Index_t idxOfNewComponent);
+private:
 
-    };//class ArrayImpl
+    //Views walk the component arrays directly.
+    template <typename IncludeList, typename ExcludeList> friend class View;
+
+    //The pool for a component ID is always the ComponentArray of that type,
+    //so the typed paths can skip the virtual calls.
+    template <typename ComponentT>
+    ComponentArray<ComponentT>& getArray()
+    {
+        return static_cast<ComponentArray<ComponentT>&>(getPool(GetIDFromType<ComponentT>()));
+    }
 
-    using ComponentArray_t = std::variant
-    <
-        ArrayImpl<Transform>
-    >;
+    ComponentPool* peekPool(Index_t componentID) const {return mPools[componentID].load(std::memory_order_acquire);}
 
-    //The array of component arrays.
-    std::array<ComponentArray_t, NUM_COMPONENT_TYPES> mComponentArrays;
+    std::array<std::atomic<ComponentPool*>, MAX_NUM_COMPONENT_TYPES> mPools{};
+    std::array<std::unique_ptr<ComponentPool>, MAX_NUM_COMPONENT_TYPES> mOwnedPools;
+    std::mutex mMakePoolMutex;
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,81 @@
+#include "ComponentRegistry.hpp"
+#include "Components.hpp"
+#include "errorHandling.hpp"
+#include <format>
+#include <algorithm>
+#include <cctype>
+
+namespace DF
+{
+
+ComponentRegistry& ComponentRegistry::get()
+{
+    //Defined here instead of in the header so the app and the dll share the one registry.
+    static ComponentRegistry registry;
+    return registry;
+}
+
+ComponentRegistry::ComponentRegistry()
+{
+    //Registered in a fixed order so the engine's components always get the same IDs.
+    registerComponent<Transform>();
+    registerComponent<Velocity>();
+    registerComponent<Hierarchy>();
+}
+
+std::string ComponentRegistry::normalizeName(std::string_view rawName)
+{
+    std::string name;
+    name.reserve(rawName.size());
+
+    constexpr std::string_view keywords[] {"struct ", "class ", "enum ", "union "};
+    for(size_t i = 0; i < rawName.size();)
+    {
+        //Only whole words, so that e.g. "myclass " is left alone.
+        auto const atWordStart {i == 0 || !(std::isalnum(static_cast<unsigned char>(rawName[i - 1])) || rawName[i - 1] == '_')};
+        auto const keyword {std::ranges::find_if(keywords, [&](std::string_view word){return atWordStart && rawName.substr(i).starts_with(word);})};
+        if(keyword != std::end(keywords))
+        {
+            i += keyword->size();
+            continue;
+        }
+
+        if(rawName[i] != ' ') {name.push_back(rawName[i]);}
+        ++i;
+    }
+
+    return name;
+}
+
+Index_t ComponentRegistry::findID(std::string_view name) const
+{
+    auto const count {getComponentCount()};
+    for(Index_t id = 0; id < count; ++id)
+    {
+        if(mInfos[id].name == name)
+            return id;
+    }
+
+    return MAX_NUM_COMPONENT_TYPES;
+}
+
+Index_t ComponentRegistry::registerComponent(ComponentInfo info)
+{
+    std::scoped_lock lock {mRegisterMutex};
+
+    if(auto const existing {findID(info.name)}; existing != MAX_NUM_COMPONENT_TYPES)
+        return existing;
+
+    auto const id {getComponentCount()};
+    if(id == MAX_NUM_COMPONENT_TYPES)
+    {
+        throw DFException{std::format("could not register component {}, the ECS only supports {} component types",
+            info.name, MAX_NUM_COMPONENT_TYPES)};
+    }
+
+    mInfos[id] = std::move(info);
+    mComponentCount.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+}
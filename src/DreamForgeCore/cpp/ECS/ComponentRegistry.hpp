@@ -0,0 +1,137 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <new>
+#include "df_export.hpp"
+#include "ComponentID.hpp"
+#include "ComponentArray.hpp"
+
+namespace DF
+{
+
+//What the ECS needs to know to store a component type it was not compiled with.
+struct ComponentInfo
+{
+    std::string name;
+    size_t size{0};
+    size_t alignment{0};
+
+    //Default construct a component in mem. Archetype chunks are untyped memory and use this.
+    void (*defaultConstruct)(void* mem){nullptr};
+
+    //Make the sparse set pool that ComponentManager stores this component type in.
+    std::unique_ptr<ComponentPool> (*makePool)(){nullptr};
+};
+
+//The name of ComponentT as the compiler spells it, e.g. "DF::Transform" or "struct DF::Transform".
+//Unlike typeid().name() this is the source spelling on every compiler, and
+//ComponentRegistry::normalizeName() takes care of what is left of the differences.
+template <typename ComponentT>
+constexpr std::string_view getRawTypeName()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    //"class std::basic_string_view<char,struct std::char_traits<char> > __cdecl DF::getRawTypeName<struct DF::Transform>(void)"
+    std::string_view const signature {__FUNCSIG__};
+    auto const begin {signature.find("getRawTypeName<") + std::string_view{"getRawTypeName<"}.size()};
+    auto const end {signature.rfind(">(void)")};
+#else
+    //GCC: "constexpr std::string_view DF::getRawTypeName() [with ComponentT = DF::Transform; std::string_view = ...]"
+    //Clang: "std::string_view DF::getRawTypeName() [ComponentT = DF::Transform]"
+    std::string_view const signature {__PRETTY_FUNCTION__};
+    auto const begin {signature.find("ComponentT = ") + std::string_view{"ComponentT = "}.size()};
+    auto const end {signature.find_first_of(";]", begin)};
+#endif
+    return signature.substr(begin, end - begin);
+}
+
+//Hands out the dense component IDs that index the component pools and the signature bits.
+//
+//The engine's own components (Components.hpp) are registered up front, so their IDs are always
+//the same. Any other type is registered the first time GetIDFromType<T>() is called for it, so
+//game code can define components in its own headers without the engine being recompiled.
+//
+//Components are identified by name. The app and the dll each get their own GetIDFromType<T>()
+//instantiation, but both find the same name in this one registry and agree on the ID.
+//Snapshots and journals store the names too, so they have to come out the same on every
+//compiler: a component can spell its name out with
+//inline static constexpr std::string_view sComponentName{"MyGame::Health"};
+//and otherwise gets its type name with the compiler specific parts taken out (see normalizeName()).
+//Types in anonymous namespaces have no name that lasts, so give those an sComponentName.
+class DF_DLL_API ComponentRegistry
+{
+public:
+
+    static ComponentRegistry& get();
+
+    //Returns the existing ID if a component with the same name is already registered.
+    //Throws a DFException if there are already MAX_NUM_COMPONENT_TYPES components.
+    Index_t registerComponent(ComponentInfo info);
+
+    template <typename ComponentT>
+    Index_t registerComponent()
+    {
+        if constexpr(requires {std::string_view{ComponentT::sComponentName};})
+            return registerComponent<ComponentT>(ComponentT::sComponentName);
+        else
+            return registerComponent<ComponentT>(normalizeName(getRawTypeName<ComponentT>()));
+    }
+
+    template <typename ComponentT>
+    Index_t registerComponent(std::string_view name)
+    {
+        static_assert(std::is_trivially_copyable_v<ComponentT>, "components are copied around as raw bytes");
+        static_assert(std::is_default_constructible_v<ComponentT>);
+
+        return registerComponent(ComponentInfo
+        {
+            .name = std::string{name},
+            .size = sizeof(ComponentT),
+            .alignment = alignof(ComponentT),
+            .defaultConstruct = [](void* mem){::new(mem) ComponentT{};},
+            .makePool = []() -> std::unique_ptr<ComponentPool> {return std::make_unique<ComponentArray<ComponentT>>();}
+        });
+    }
+
+    //Drops the "struct ", "class ", "enum " and "union " MSVC puts in front of type names and
+    //every space, so that e.g. "struct Foo<unsigned int, 3>" and "Foo<unsigned int,3>" match.
+    static std::string normalizeName(std::string_view rawName);
+
+    //Returns MAX_NUM_COMPONENT_TYPES if nothing is registered under name.
+    Index_t findID(std::string_view name) const;
+
+    //Infos are never moved or changed once they are registered, so this doesnt need a lock.
+    ComponentInfo const& getInfo(Index_t id) const {return mInfos[id];}
+
+    size_t getComponentCount() const {return mComponentCount.load(std::memory_order_acquire);}
+
+private:
+
+    ComponentRegistry();
+    ~ComponentRegistry()=default;
+
+    ComponentRegistry(ComponentRegistry const&)=delete;
+    ComponentRegistry(ComponentRegistry&&)=delete;
+    ComponentRegistry& operator=(ComponentRegistry const&)=delete;
+    ComponentRegistry& operator=(ComponentRegistry&&)=delete;
+
+    //Only taken to register. Readers only look at the first mComponentCount infos.
+    mutable std::mutex mRegisterMutex;
+
+    std::array<ComponentInfo, MAX_NUM_COMPONENT_TYPES> mInfos;
+    std::atomic<size_t> mComponentCount{0};
+};
+
+//Get the ID mapped to ComponentT, registering ComponentT the first time.
+template <typename ComponentT>
+Index_t GetIDFromType()
+{
+    static Index_t const id {ComponentRegistry::get().registerComponent<ComponentT>()};
+    return id;
+}
+
+}
@@ -1,7 +1,12 @@
 #pragma once
 #include "HelpfulTypeAliases.hpp"
 #include "glm/glm.hpp"
-#include "BiDirectionalTypeIntMap.hpp"
+#include "Entity.hpp"
+#include "ComponentRegistry.hpp"
+
+//Any trivially copyable, default constructible struct can be a component, including ones
+//defined outside of the engine. See ComponentRegistry.hpp. The engine's own components
+//are also listed in ComponentRegistry.cpp so that their IDs never change.
 
 struct Transform
 {
@@ -10,21 +15,15 @@ struct Transform
     F64 rotation{};
 };
 
-//Below are meta functions for a compile time type to integer map.
-//see BiDirectionalTypeIntMap.hpp
-//Remeber to update the macro when you add and remove component types.
-
-#define TYPE_REGISTRY TypeRegistry< \
-    Transform> \
-
-//Get the type mapped to ID.
-template <Index_t ID>
-using GetTypeFromID = TYPE_REGISTRY::IndexedMap::type<ID>;
-
-//Get the ID mapped to ComponentT.
-template <typename ComponentT>
-inline static Index_t GetIDFromType =
-    TYPE_REGISTRY::IndexedMap::index<ComponentT>;
+struct Velocity
+{
+    glm::vec2 linear{};
+    F64 angular{};
+};
 
-inline constexpr auto NUM_COMPONENT_TYPES = TYPE_REGISTRY::sNumTypes;
-inline constexpr auto MAX_NUM_COMPONENT_TYPES = TYPE_REGISTRY::sMaxNumTypes;
\ No newline at end of file
+//Makes an entity's Transform relative to its parent's. A null parent makes it a root.
+//See TransformHierarchy.hpp. Call ECS::markChanged<Hierarchy>() after changing the parent.
+struct Hierarchy
+{
+    DF::Entity parent{};
+};
@@ -0,0 +1,473 @@
+#include "DeltaRecorder.hpp"
+#include "ECS.hpp"
+#include "ECSSnapshot.hpp"
+#include "MappedFile.hpp"
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <string_view>
+
+namespace DF
+{
+
+//A delta is a list of these, each followed by size bytes of component (padded to 8 bytes).
+//Records are always copied out with memcpy, so the bytes dont need to be aligned.
+struct DeltaRecord
+{
+    U64 entity{0};
+    U32 size{0};
+    U16 componentID{0};
+    U8 op{0};
+    U8 padding{0};
+};
+
+//Journal files are a list of blocks, one per appendJournal(). Every block starts with this, then
+//the name and size of every component ID the block uses, then the frames as [U64 size][delta bytes].
+struct JournalBlockHeader
+{
+    std::array<char, 4> magic{'D', 'F', 'D', 'J'};
+    U32 version{1};
+    U32 componentCount{0};
+    U32 frameCount{0};
+};
+
+static size_t padTo8(size_t size)
+{
+    return (size + 7) & ~size_t{7};
+}
+
+static Entity toEntity(U64 id)
+{
+    return Entity{static_cast<U32>(id), static_cast<U32>(id >> 32)};
+}
+
+static void appendRecord(std::vector<std::byte>& delta, ECS::JournalOp op,
+    Entity const& entity, Index_t componentID, void const* component = nullptr, size_t size = 0)
+{
+    DeltaRecord const record {entity.getID(), static_cast<U32>(size),
+        static_cast<U16>(componentID), static_cast<U8>(op)};
+
+    auto const at {delta.size()};
+    delta.resize(at + sizeof(DeltaRecord) + padTo8(size));
+    std::memcpy(delta.data() + at, &record, sizeof(DeltaRecord));
+    if(size != 0) {std::memcpy(delta.data() + at + sizeof(DeltaRecord), component, size);}
+}
+
+//Calls fn(DeltaRecord const&, std::byte const* component) for every record of a delta, in order.
+//Stops and returns false at the first record whose component doesnt fit in what is left of delta,
+//which only happens with deltas read back from a corrupt file.
+template <typename Func>
+static bool eachRecord(std::span<std::byte const> delta, Func&& fn)
+{
+    for(size_t at = 0; at < delta.size();)
+    {
+        if(delta.size() - at < sizeof(DeltaRecord)) {return false;}
+
+        DeltaRecord record;
+        std::memcpy(&record, delta.data() + at, sizeof(DeltaRecord));
+        if(padTo8(record.size) > delta.size() - at - sizeof(DeltaRecord)) {return false;}
+
+        fn(record, delta.data() + at + sizeof(DeltaRecord));
+        at += sizeof(DeltaRecord) + padTo8(record.size);
+    }
+    return true;
+}
+
+static void applyToWorld(ECS& ecs, DeltaRecord const& record, Index_t componentID, std::byte const* component)
+{
+    auto const entity {toEntity(record.entity)};
+
+    switch(static_cast<ECS::JournalOp>(record.op))
+    {
+    case ECS::JournalOp::CREATE_ENTITY: ecs.restoreEntity(entity); break;
+    case ECS::JournalOp::DESTROY_ENTITY: ecs.removeEntity(entity); break;
+    case ECS::JournalOp::WRITE_COMPONENT: ecs.setComponentByID(entity, componentID, component); break;
+    case ECS::JournalOp::REMOVE_COMPONENT: ecs.removeComponentByID(entity, componentID); break;
+    }
+}
+
+DeltaRecorder::DeltaRecorder(size_t maxFrames, size_t maxBytes)
+    : mMaxFrames{std::max<size_t>(maxFrames, 1)}, mMaxBytes{maxBytes}
+{
+}
+
+void DeltaRecorder::start()
+{
+    auto& ecs {ECS::get()};
+    auto const& registry {ComponentRegistry::get()};
+    auto const& entities {ecs.getEntityManager()};
+
+    mFrames.clear();
+    mByteSize = 0;
+    mBaseFrame = 0;
+    mCurrentFrame = 0;
+    mIsJournalBroken = true;
+
+    mBaseEntities.resetSlots(entities.getSlotCount(), entities.getFreeListHead(), entities.getCurrentEntityCount());
+    for(U32 idx = 0; idx < entities.getSlotCount(); ++idx)
+    {
+        auto const state {entities.getSlotState(idx)};
+        mBaseEntities.restoreSlot(idx, state, entities.getSignature(Entity{idx, state.generation}));
+    }
+    mBaseEntities.relinkFreeList();
+
+    for(Index_t id = 0; id < registry.getComponentCount(); ++id)
+    {
+        auto const size {registry.getInfo(id).size};
+        mBaseComponents[id].clear();
+
+        ecs.eachComponentByID(id, [this, id, size](std::span<Entity const> owners, std::byte const* components)
+        {
+            for(size_t row = 0; row < owners.size(); ++row)
+                setBaseComponent(owners[row], id, components + row * size);
+        });
+    }
+
+    //Start a fresh tick so the components stamped before now get journaled the next time they change.
+    ecs.setJournaling(true);
+    ecs.advanceChangeTick();
+    mIsRecording = true;
+}
+
+void DeltaRecorder::stop()
+{
+    ECS::get().setJournaling(false);
+    mIsRecording = false;
+    mIsJournalBroken = true;
+
+    mFrames.clear();
+    mByteSize = 0;
+    for(auto& components : mBaseComponents)
+        components = {};
+}
+
+void DeltaRecorder::captureFrame()
+{
+    if(!mIsRecording) {return;}
+
+    auto& ecs {ECS::get()};
+    auto const& registry {ComponentRegistry::get()};
+
+    //Capturing after seeking back starts a new timeline from there.
+    dropFramesAfter(mCurrentFrame);
+
+    Frame frame;
+    if(!mSpareFrames.empty())
+    {
+        frame = std::move(mSpareFrames.back());
+        mSpareFrames.pop_back();
+    }
+
+    //Structural changes go in the order they happened. Component values are read now, after
+    //all of them, so a component written many times only goes in once with its final value.
+    mWrites.clear();
+    ecs.eachJournalEntry([this, &frame](ECS::JournalEntry const& entry)
+    {
+        if(entry.op == ECS::JournalOp::WRITE_COMPONENT)
+            mWrites.push_back({entry.entity, entry.componentID});
+        else
+            appendRecord(frame.bytes, entry.op, entry.entity, entry.componentID);
+    });
+
+    std::sort(mWrites.begin(), mWrites.end(), [](Write const& lhs, Write const& rhs)
+    {
+        return lhs.entity.getID() != rhs.entity.getID() ?
+            lhs.entity.getID() < rhs.entity.getID() : lhs.componentID < rhs.componentID;
+    });
+
+    mWrites.erase(std::unique(mWrites.begin(), mWrites.end(), [](Write const& lhs, Write const& rhs)
+    {
+        return lhs.entity == rhs.entity && lhs.componentID == rhs.componentID;
+    }), mWrites.end());
+
+    //Entities that died or lost the component since dont have anything to write.
+    for(auto const& [entity, id] : mWrites)
+    {
+        if(auto const* component {ecs.getComponentByID(entity, id)}; component)
+            appendRecord(frame.bytes, ECS::JournalOp::WRITE_COMPONENT, entity, id, component, registry.getInfo(id).size);
+    }
+
+    ecs.clearJournal();
+
+    //markChanged() only journals the first mark of a tick, so every frame needs its own.
+    ecs.advanceChangeTick();
+
+    mByteSize += frame.bytes.size();
+    mFrames.push_back(std::move(frame));
+    mCurrentFrame = getNewestFrame();
+
+    while(mFrames.size() > mMaxFrames || (mByteSize > mMaxBytes && mFrames.size() > 1))
+        foldOldestFrame();
+}
+
+bool DeltaRecorder::seek(U64 frame)
+{
+    if(!mIsRecording || frame < mBaseFrame || frame > getNewestFrame())
+        return false;
+
+    auto& ecs {ECS::get()};
+    auto const& registry {ComponentRegistry::get()};
+
+    //Rebuild the world at mBaseFrame by writing the copy out as a snapshot and loading that.
+    mSnapshotScratch.clear();
+    writeSnapshot(mBaseEntities,
+        [this, &registry](Index_t id, SnapshotBlockFn const& fn)
+        {
+            auto const size {registry.getInfo(id).size};
+            for(U32 idx = 0; idx < mBaseEntities.getSlotCount(); ++idx)
+            {
+                Entity const entity {idx, mBaseEntities.getSlotState(idx).generation};
+                if(mBaseEntities.getSignature(entity).test(id))
+                    fn({&entity, 1}, mBaseComponents[id].data() + idx * size);
+            }
+        },
+        [this](void const* data, size_t size)
+        {
+            auto const* bytes {static_cast<std::byte const*>(data)};
+            mSnapshotScratch.insert(mSnapshotScratch.end(), bytes, bytes + size);
+        });
+
+    if(ecs.loadSnapshot(mSnapshotScratch))
+        return false;
+
+    for(auto i {mBaseFrame}; i < frame; ++i)
+    {
+        eachRecord(mFrames[i - mBaseFrame].bytes, [&ecs](DeltaRecord const& record, std::byte const* component)
+        {
+            applyToWorld(ecs, record, record.componentID, component);
+        });
+    }
+
+    //Replaying journals everything again, none of which is new. Everything replayed was also
+    //stamped with the current tick, so move on from it or the next marks wouldnt get journaled.
+    ecs.clearJournal();
+    ecs.advanceChangeTick();
+    mCurrentFrame = frame;
+    return true;
+}
+
+MaybeError DeltaRecorder::restartJournal(std::filesystem::path const& path)
+{
+    std::ofstream out {path, std::ios::binary | std::ios::trunc};
+    if(!out)
+        return Error{Error::Code::COULD_NOT_OPEN_FILE};
+
+    mJournaledFrame = mCurrentFrame;
+    mIsJournalBroken = !mIsRecording;
+    return std::nullopt;
+}
+
+MaybeError DeltaRecorder::appendJournal(std::filesystem::path const& path)
+{
+    if(mIsJournalBroken || mJournaledFrame < mBaseFrame || mJournaledFrame > mCurrentFrame)
+        return Error{Error::Code::DELTA_JOURNAL_GAP};
+
+    if(mJournaledFrame == mCurrentFrame)
+        return std::nullopt;
+
+    std::ofstream out {path, std::ios::binary | std::ios::app};
+    if(!out)
+        return Error{Error::Code::COULD_NOT_OPEN_FILE};
+
+    auto const& registry {ComponentRegistry::get()};
+    JournalBlockHeader const header
+    {
+        .componentCount = static_cast<U32>(registry.getComponentCount()),
+        .frameCount = static_cast<U32>(mCurrentFrame - mJournaledFrame)
+    };
+    out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+    for(Index_t id = 0; id < header.componentCount; ++id)
+    {
+        auto const& info {registry.getInfo(id)};
+        U32 const nameLength {static_cast<U32>(info.name.size())};
+        U32 const size {static_cast<U32>(info.size)};
+        out.write(reinterpret_cast<char const*>(&nameLength), sizeof(nameLength));
+        out.write(reinterpret_cast<char const*>(&size), sizeof(size));
+        out.write(info.name.data(), nameLength);
+    }
+
+    for(auto i {mJournaledFrame}; i < mCurrentFrame; ++i)
+    {
+        auto const& bytes {mFrames[i - mBaseFrame].bytes};
+        U64 const size {bytes.size()};
+        out.write(reinterpret_cast<char const*>(&size), sizeof(size));
+        out.write(reinterpret_cast<char const*>(bytes.data()), static_cast<std::streamsize>(size));
+    }
+
+    if(!out)
+        return Error{Error::Code::COULD_NOT_OPEN_FILE};
+
+    mJournaledFrame = mCurrentFrame;
+    return std::nullopt;
+}
+
+MaybeError DeltaRecorder::replayJournal(std::filesystem::path const& path)
+{
+    auto maybeFile {MappedFile::open(path)};
+    if(!maybeFile)
+        return maybeFile.error();
+
+    auto const bytes {maybeFile->getBytes()};
+    auto& ecs {ECS::get()};
+    auto const& registry {ComponentRegistry::get()};
+
+    //Reads size bytes at at into out, or returns false if the file ends first.
+    size_t at {0};
+    auto const read {[&bytes, &at](void* out, size_t size)
+    {
+        if(size > bytes.size() - at) {return false;}
+        std::memcpy(out, bytes.data() + at, size);
+        at += size;
+        return true;
+    }};
+
+    auto const invalid {[&path]() -> MaybeError
+    {
+        Logger::get().fmtStdoutError("could not replay journal {}, it is corrupt", path.string());
+        return Error{Error::Code::INVALID_SNAPSHOT};
+    }};
+
+    while(at < bytes.size())
+    {
+        JournalBlockHeader header;
+        if(!read(&header, sizeof(header)) || header.magic != JournalBlockHeader{}.magic ||
+            header.version != JournalBlockHeader{}.version || header.componentCount > MAX_NUM_COMPONENT_TYPES)
+        {
+            return invalid();
+        }
+
+        //Journal component ID to the ID in this program, or MAX_NUM_COMPONENT_TYPES to skip it.
+        std::array<Index_t, MAX_NUM_COMPONENT_TYPES> idOf{};
+        for(U32 i = 0; i < header.componentCount; ++i)
+        {
+            U32 nameLength {0};
+            U32 size {0};
+            if(!read(&nameLength, sizeof(nameLength)) || !read(&size, sizeof(size)) || nameLength > bytes.size() - at)
+                return invalid();
+
+            std::string_view const name {reinterpret_cast<char const*>(bytes.data() + at), nameLength};
+            at += nameLength;
+
+            idOf[i] = registry.findID(name);
+            if(idOf[i] != MAX_NUM_COMPONENT_TYPES && registry.getInfo(idOf[i]).size != size)
+                idOf[i] = MAX_NUM_COMPONENT_TYPES;
+        }
+
+        for(U32 frame = 0; frame < header.frameCount; ++frame)
+        {
+            U64 size {0};
+            if(!read(&size, sizeof(size)) || size > bytes.size() - at)
+                return invalid();
+
+            //Check the whole frame before applying any of it, so a corrupt frame isnt half applied.
+            auto const delta {bytes.subspan(at, size)};
+            bool isValid {true};
+
+            //Entities are always made in the lowest free slot or the next fresh one,
+            //so a real journal never creates past the slots in use plus what it created.
+            U64 slotLimit {ecs.getEntityManager().getSlotCount()};
+            auto const isDeltaWellFormed {eachRecord(delta, [&](DeltaRecord const& record, std::byte const*)
+            {
+                switch(static_cast<ECS::JournalOp>(record.op))
+                {
+                case ECS::JournalOp::CREATE_ENTITY:
+                    isValid = isValid && toEntity(record.entity).getIndex() <= slotLimit++;
+                    break;
+                case ECS::JournalOp::DESTROY_ENTITY:
+                    break;
+                case ECS::JournalOp::REMOVE_COMPONENT:
+                    isValid = isValid && record.componentID < header.componentCount;
+                    break;
+                case ECS::JournalOp::WRITE_COMPONENT:
+                    //Components this program doesnt know are skipped, but the ones it does
+                    //are copied straight in, so their size has to be exactly right.
+                    isValid = isValid && record.componentID < header.componentCount &&
+                        (idOf[record.componentID] == MAX_NUM_COMPONENT_TYPES ||
+                        record.size == registry.getInfo(idOf[record.componentID]).size);
+                    break;
+                default:
+                    isValid = false;
+                }
+            })};
+
+            if(!isDeltaWellFormed || !isValid)
+                return invalid();
+
+            eachRecord(delta, [&](DeltaRecord const& record, std::byte const* component)
+            {
+                auto const op {static_cast<ECS::JournalOp>(record.op)};
+                bool const usesComponent {op == ECS::JournalOp::WRITE_COMPONENT || op == ECS::JournalOp::REMOVE_COMPONENT};
+                if(usesComponent && idOf[record.componentID] == MAX_NUM_COMPONENT_TYPES)
+                    return;
+
+                applyToWorld(ecs, record, usesComponent ? idOf[record.componentID] : 0, component);
+            });
+
+            at += size;
+        }
+    }
+
+    return std::nullopt;
+}
+
+void DeltaRecorder::foldOldestFrame()
+{
+    auto& oldest {mFrames.front()};
+
+    eachRecord(oldest.bytes, [this](DeltaRecord const& record, std::byte const* component)
+    {
+        auto const entity {toEntity(record.entity)};
+        auto const op {static_cast<ECS::JournalOp>(record.op)};
+
+        if(op == ECS::JournalOp::CREATE_ENTITY)
+            mBaseEntities.claimEntity(entity);
+        else if(!mBaseEntities.isAlive(entity))
+            return;
+        else if(op == ECS::JournalOp::DESTROY_ENTITY)
+            mBaseEntities.removeEntity(entity);
+        else if(op == ECS::JournalOp::REMOVE_COMPONENT)
+            mBaseEntities.setSignatureBit(entity, record.componentID, false);
+        else
+        {
+            mBaseEntities.setSignatureBit(entity, record.componentID);
+            setBaseComponent(entity, record.componentID, component);
+        }
+    });
+
+    //An autosave journal cant continue past a frame it never got.
+    if(mJournaledFrame <= mBaseFrame) {mIsJournalBroken = true;}
+
+    mByteSize -= oldest.bytes.size();
+    oldest.bytes.clear();
+    mSpareFrames.push_back(std::move(oldest));
+    mFrames.pop_front();
+    ++mBaseFrame;
+}
+
+void DeltaRecorder::setBaseComponent(Entity const& entity, Index_t componentID, void const* value)
+{
+    auto const size {ComponentRegistry::get().getInfo(componentID).size};
+    auto& components {mBaseComponents[componentID]};
+
+    auto const offset {static_cast<size_t>(entity.getIndex()) * size};
+    if(components.size() < offset + size)
+        components.resize(std::max(offset + size, components.size() * 2));
+
+    std::memcpy(components.data() + offset, value, size);
+}
+
+void DeltaRecorder::dropFramesAfter(U64 frame)
+{
+    while(getNewestFrame() > frame)
+    {
+        mByteSize -= mFrames.back().bytes.size();
+        mFrames.back().bytes.clear();
+        mSpareFrames.push_back(std::move(mFrames.back()));
+        mFrames.pop_back();
+    }
+
+    if(mJournaledFrame > frame) {mIsJournalBroken = true;}
+}
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include "HelpfulTypeAliases.hpp"
+#include "errorHandling.hpp"
+#include "EntityManager.hpp"
+#include "ComponentID.hpp"
+#include "df_export.hpp"
+
+namespace DF
+{
+
+//Records what changed in the ECS every frame into a ring of deltas, for rewinding,
+//deterministic replay and autosaving without stopping the world.
+//
+//start() copies the world once. After that captureFrame() only reads the ECS journal
+//(see ECS::setJournaling()), so its cost follows how much changed and not how big the world is.
+//A delta holds the entities created and destroyed, the components removed, and the current value
+//of every component that was added or marked as changed. Writes that are not marked with
+//ECS::markChanged() or ECS::patch() are not seen, same as for reactive views.
+//
+//When the ring is full the oldest delta is folded into the copy start() made. seek() rebuilds
+//the world from that copy and then replays the deltas up to the requested frame.
+class DF_DLL_API DeltaRecorder
+{
+public:
+
+    inline constexpr static size_t sDefaultMaxFrames{600};
+    inline constexpr static size_t sDefaultMaxBytes{64 * 1024 * 1024};
+
+    //The ring drops its oldest deltas once it holds more than maxFrames or maxBytes of them.
+    explicit DeltaRecorder(size_t maxFrames = sDefaultMaxFrames, size_t maxBytes = sDefaultMaxBytes);
+    ~DeltaRecorder()=default;
+
+    DeltaRecorder(DeltaRecorder const&)=delete;
+    DeltaRecorder(DeltaRecorder&&)=delete;
+    DeltaRecorder& operator=(DeltaRecorder const&)=delete;
+    DeltaRecorder& operator=(DeltaRecorder&&)=delete;
+
+    //Throw away any recorded frames, copy the world and turn on ECS journaling.
+    //Costs as much as the world is big, so do it on level load (and after ECS::loadSnapshot()).
+    void start();
+    void stop();
+    bool isRecording() const {return mIsRecording;}
+
+    //Turn everything journaled since the last capture into a delta. Call it once per frame at
+    //a sync point after the structural changes are flushed (ApplicationBase does when recording).
+    void captureFrame();
+
+    //The frames seek() can go to. Frame getOldestFrame() is the world before the oldest delta.
+    U64 getOldestFrame() const {return mBaseFrame;}
+    U64 getNewestFrame() const {return mBaseFrame + mFrames.size();}
+    U64 getCurrentFrame() const {return mCurrentFrame;}
+    size_t getByteSize() const {return mByteSize;}
+
+    //Rebuild the world as it was right after frame was captured. The frames after it are kept,
+    //so seeking forward again replays them, until the next captureFrame() which starts a new timeline
+    //from frame. Returns false if frame isnt in the ring. Call at a sync point.
+    //Handles kept outside of the ECS from after frame can look alive again, so drop them.
+    bool seek(U64 frame);
+
+    //Autosaving: save a snapshot (ECS::saveSnapshot()), then call restartJournal() to start an empty
+    //journal file that continues from it. appendJournal() then only writes the deltas captured since
+    //its last call. Loading is ECS::loadSnapshot() followed by replayJournal().
+    MaybeError restartJournal(std::filesystem::path const& path);
+    MaybeError appendJournal(std::filesystem::path const& path);
+    static MaybeError replayJournal(std::filesystem::path const& path);
+
+private:
+
+    struct Frame
+    {
+        std::vector<std::byte> bytes;
+    };
+
+    struct Write
+    {
+        Entity entity;
+        Index_t componentID;
+    };
+
+    size_t mMaxFrames;
+    size_t mMaxBytes;
+
+    bool mIsRecording{false};
+
+    //Frame numbers. mFrames[i] takes frame mBaseFrame + i to mBaseFrame + i + 1.
+    U64 mBaseFrame{0};
+    U64 mCurrentFrame{0};
+
+    std::deque<Frame> mFrames;
+    size_t mByteSize{0};
+
+    //The world at mBaseFrame. Components are stored by entity index.
+    EntityManager mBaseEntities;
+    std::array<std::vector<std::byte>, MAX_NUM_COMPONENT_TYPES> mBaseComponents;
+
+    //Frames up to here have been written to the journal file.
+    U64 mJournaledFrame{0};
+    bool mIsJournalBroken{true};
+
+    //Reused between frames so capturing doesnt allocate once it has warmed up.
+    std::vector<Write> mWrites;
+    std::vector<Frame> mSpareFrames;
+    std::vector<std::byte> mSnapshotScratch;
+
+    void foldOldestFrame();
+    void setBaseComponent(Entity const& entity, Index_t componentID, void const* value);
+    void dropFramesAfter(U64 frame);
+};
+
+}
@@ -1,2 +1,197 @@
 #include "ECS.hpp"
+#include <algorithm>
+#include <cstring>
 
+namespace DF
+{
+
+ECS::ECS() : mJournals(ThreadPool::get().getWorkerCount() + 1)
+{
+    for(U32 i = 0; i < ThreadPool::get().getWorkerCount() + 1; ++i)
+    {
+        mCommandBuffers.emplace_back(i);
+        mFlushBuffers.emplace_back(i);
+    }
+}
+
+void ECS::flushCommands()
+{
+    auto const hasCommands {[this]
+    {
+        return std::ranges::any_of(mCommandBuffers, [](CommandBuffer const& buffer){return !buffer.isEmpty();});
+    }};
+
+    for(U32 pass = 0; hasCommands(); ++pass)
+    {
+        if(pass == sMaxFlushPasses)
+        {
+            Logger::get().fmtStdoutError("event listeners were still recording commands after {} flush passes, "
+                "the rest are left for the next flushCommands()", sMaxFlushPasses);
+            return;
+        }
+
+        mCommandBuffers.swap(mFlushBuffers);
+        applyCommands(mFlushBuffers);
+
+        for(auto& buffer : mFlushBuffers)
+            buffer.clear();
+    }
+}
+
+void ECS::applyCommands(std::vector<CommandBuffer> const& buffers)
+{
+    mFlushScratch.clear();
+
+    for(auto const& buffer : buffers)
+    {
+        if(buffer.isEmpty()) {continue;}
+
+        //Make the buffer's pending entities real first, so commands can be redirected to them.
+        //Slot 0 is left as a null entity, for pending handles from other buffers.
+        mCreatedEntities.assign(buffer.getPendingEntityCount() + 1, Entity{});
+        for(auto const& command : buffer.getCommands())
+        {
+            if(command.type != CommandBuffer::CommandType::CREATE_ENTITY) {continue;}
+
+            if(auto maybeEntity {mEntityManager.makeEntity()}; maybeEntity)
+            {
+                mCreatedEntities[buffer.getPendingSlot(command.entity)] = *maybeEntity;
+                journal(*maybeEntity, JournalOp::CREATE_ENTITY);
+                mEventBus.notify(EntityCreatedEvent{*maybeEntity});
+            }
+            else
+                Logger::get().stdoutError(maybeEntity.error().getStr());
+        }
+
+        for(auto const& command : buffer.getCommands())
+        {
+            if(command.type == CommandBuffer::CommandType::CREATE_ENTITY) {continue;}
+
+            auto entity {command.entity};
+            if(CommandBuffer::isPending(entity))
+            {
+#ifdef DF_DEBUG
+                if(buffer.getPendingSlot(entity) == 0)
+                    Logger::get().stdoutError("a command used a pending entity from another thread's command buffer, "
+                        "it was dropped");
+#endif
+                entity = mCreatedEntities[buffer.getPendingSlot(entity)];
+            }
+
+            mFlushScratch.push_back({entity, &command,
+                command.type == CommandBuffer::CommandType::ADD_COMPONENT ?
+                    buffer.getPayload(command.payloadOffset) : nullptr});
+        }
+    }
+
+    std::stable_sort(mFlushScratch.begin(), mFlushScratch.end(),
+        [](PendingCommand const& lhs, PendingCommand const& rhs)
+        {
+            return lhs.entity.getIndex() < rhs.entity.getIndex();
+        });
+
+    for(auto const& [entity, command, payload] : mFlushScratch)
+    {
+        //The entity may have been destroyed by an earlier command, or creating it may have failed.
+        if(!mEntityManager.isAlive(entity)) {continue;}
+
+        auto const id {command->componentID};
+
+        switch(command->type)
+        {
+        case CommandBuffer::CommandType::DESTROY_ENTITY:
+        {
+            removeEntity(entity);
+            break;
+        }
+        case CommandBuffer::CommandType::ADD_COMPONENT:
+        {
+            //Overwrites the component in place if the entity already has one, which only counts as a change.
+            setComponentByID(entity, id, payload);
+            break;
+        }
+        case CommandBuffer::CommandType::REMOVE_COMPONENT:
+        {
+            removeComponentByID(entity, id);
+            break;
+        }
+        case CommandBuffer::CommandType::CREATE_ENTITY:
+            break;
+        }
+    }
+}
+
+void ECS::setComponentByID(Entity const& entity, Index_t componentID, void const* value)
+{
+    if(!mEntityManager.isAlive(entity)) {return;}
+
+    auto const tick {getChangeTick()};
+    if(auto* component {getComponentByID(entity, componentID)}; component)
+    {
+        std::memcpy(component, value, ComponentRegistry::get().getInfo(componentID).size);
+
+        if(mStorageMode == StorageMode::ARCHETYPE) {mArchetypeManager.markChanged(entity, componentID, tick);}
+        else {mComponentManager.getPool(componentID).markChanged(entity, tick);}
+
+        journal(entity, JournalOp::WRITE_COMPONENT, componentID);
+        return;
+    }
+
+    //The archetype storage throws if the components dont fit in a chunk, so only set the bit after.
+    if(mStorageMode == StorageMode::ARCHETYPE) {mArchetypeManager.insertComponentByID(entity, componentID, value, tick);}
+    else {mComponentManager.insertComponentByID(entity, componentID, value, tick);}
+    mEntityManager.setSignatureBit(entity, componentID);
+
+    journal(entity, JournalOp::WRITE_COMPONENT, componentID);
+    mEventBus.notify(ComponentAddedEvent{entity, componentID});
+}
+
+void ECS::removeComponentByID(Entity const& entity, Index_t componentID)
+{
+    if(!mEntityManager.isAlive(entity) || !mEntityManager.getSignature(entity).test(componentID)) {return;}
+
+    mEventBus.notify(ComponentRemovedEvent{entity, componentID});
+    logRemovals(entity, Signature_t{}.set(componentID));
+    journal(entity, JournalOp::REMOVE_COMPONENT, componentID);
+    mEntityManager.setSignatureBit(entity, componentID, false);
+
+    if(mStorageMode == StorageMode::ARCHETYPE) {mArchetypeManager.removeComponentByID(entity, componentID);}
+    else {mComponentManager.removeComponentByID(entity, componentID);}
+}
+
+bool ECS::restoreEntity(Entity const& entity)
+{
+    if(!mEntityManager.claimEntity(entity)) {return false;}
+
+    journal(entity, JournalOp::CREATE_ENTITY);
+    mEventBus.notify(EntityCreatedEvent{entity});
+    return true;
+}
+
+void ECS::clear()
+{
+    std::vector<Entity> alive;
+    alive.reserve(mEntityManager.getCurrentEntityCount());
+    mEntityManager.eachAlive([&alive](Entity entity){alive.push_back(entity);});
+
+    for(auto const& entity : alive)
+        removeEntity(entity);
+}
+
+void ECS::trimRemovedLogs(U32 tick)
+{
+    for(size_t id = 0; id < MAX_NUM_COMPONENT_TYPES; ++id)
+        trimRemovedLog(id, tick);
+}
+
+void ECS::trimRemovedLog(size_t componentID, U32 tick)
+{
+    auto& log {mRemovedLogs[componentID]};
+    auto const firstKept {std::find_if(log.begin(), log.end(),
+        [tick](RemovedComponent const& removed){return removed.tick > tick;})};
+
+    if(firstKept != log.begin()) {mTrimmedUpTo[componentID] = std::max(mTrimmedUpTo[componentID], std::prev(firstKept)->tick);}
+    log.erase(log.begin(), firstKept);
+}
+
+}
@@ -1,9 +1,19 @@
 #pragma once
 #include <memory>
+#include <atomic>
+#include <array>
+#include <filesystem>
+#include <span>
 #include "EntityManager.hpp"
 #include "ComponentManager.hpp"
+#include "ArchetypeManager.hpp"
+#include "View.hpp"
+#include "CommandBuffer.hpp"
+#include "ThreadPool.hpp"
+#include <vector>
 #include "Logging.hpp"
 #include "ECSEvents.hpp"
+#include "ChangeTracking.hpp"
 
 namespace DF 
 {
@@ -16,6 +26,30 @@ public:
         static ECS ecs;
         return ecs;
     }
+
+    //SPARSE_SET keeps one packed array per component type (ComponentManager).
+    //Adding and removing components is cheap, and so is iterating one component type.
+    //ARCHETYPE groups entities with the same signature into chunks (ArchetypeManager).
+    //Iterating several component types at once is fastest, but adding and removing
+    //components moves the entity between archetypes.
+    enum struct StorageMode : U8
+    {
+        SPARSE_SET,
+        ARCHETYPE
+    };
+
+    //Can only be changed while there are no entities.
+    void setStorageMode(StorageMode mode)
+    {
+        if(mEntityManager.getCurrentEntityCount() != 0)
+        {
+            Logger::get().stdoutError("ECS::setStorageMode() called while entities exist");
+            return;
+        }
+        mStorageMode = mode;
+    }
+
+    auto getStorageMode() const {return mStorageMode;}
     
     //Add an entity and optionally give it any number of components.
     template <typename ...ComponentTs>
@@ -28,36 +62,311 @@ public:
             return maybeEntity;
         }
 
+        journal(*maybeEntity, JournalOp::CREATE_ENTITY);
+        mEventBus.notify(EntityCreatedEvent{*maybeEntity});
         addComponents<ComponentTs...>(*maybeEntity);
 
         return maybeEntity;
     }
     
-    //Remove an entity from the ECS.
+    //Remove an entity from the ECS. Stale or already removed handles are ignored.
     void removeEntity(Entity const& entity)
     {
-        mEntityManager.removeEntity();
-        mComponentManager.removeComponents(entity);
+        if(!mEntityManager.isAlive(entity)) {return;}
+
+        //Sent before anything is removed so listeners can still read the entity's components.
+        mEventBus.notify(EntityDestroyedEvent{entity});
+        logRemovals(entity, mEntityManager.getSignature(entity));
+        journal(entity, JournalOp::DESTROY_ENTITY);
+
+        if(mStorageMode == StorageMode::ARCHETYPE)
+            mArchetypeManager.removeAllComponents(entity);
+        else
+            mComponentManager.removeAllComponents(entity);
+
+        mEntityManager.removeEntity(entity);
+    }
+
+    bool isAlive(Entity const& entity) const {return mEntityManager.isAlive(entity);}
+
+    //Optional. Allocate room for entityCount entities, and entityCount of each ComponentTs,
+    //up front so that spawning them later doesnt allocate. Storage grows on its own either way.
+    template <typename ...ComponentTs>
+    void reserve(size_t entityCount)
+    {
+        mEntityManager.reserve(entityCount);
+        mComponentManager.reserve<ComponentTs...>(entityCount);
     }
     
     //Add any number of components to an already existing entity.
     template <typename ...ComponentTs>
     void addComponents(Entity const& entity)
     {
-        (entity.setSignature<ComponentTs>(), ...);
-        mComponentManager.insertComponents<ComponentTs...>(entity);
+        if(!mEntityManager.isAlive(entity)) {return;}
+        auto const tick {getChangeTick()};
+        if(mStorageMode == StorageMode::ARCHETYPE)
+            mArchetypeManager.insertComponents<ComponentTs...>(entity, tick);
+        else
+            mComponentManager.insertComponents<ComponentTs...>(entity, tick);
+
+        //After the insert, which throws if the archetype storage cant fit the components.
+        (mEntityManager.setSignatureBit<ComponentTs>(entity), ...);
+
+        (journal(entity, JournalOp::WRITE_COMPONENT, GetIDFromType<ComponentTs>()), ...);
+        (mEventBus.notify(ComponentAddedEvent{entity, GetIDFromType<ComponentTs>()}), ...);
     }
     
-    //Remove any number of components from an entity.
+    //Remove any number of components from an entity. The ones it doesnt have are ignored.
     template <typename ...ComponentTs>
     void removeComponents(Entity const& entity)
     {
-        (mComponentManager.removeComponents<ComponentTs>(entity), ...);
+        if(!mEntityManager.isAlive(entity)) {return;}
+
+        //The storages only check for missing components in debug builds.
+        auto const removed {mEntityManager.getSignature(entity) & makeSignature<ComponentTs...>()};
+        if(removed != makeSignature<ComponentTs...>())
+        {
+            (removeComponentByID(entity, GetIDFromType<ComponentTs>()), ...);
+            return;
+        }
+
+        (mEventBus.notify(ComponentRemovedEvent{entity, GetIDFromType<ComponentTs>()}), ...);
+        logRemovals(entity, removed);
+        (journal(entity, JournalOp::REMOVE_COMPONENT, GetIDFromType<ComponentTs>()), ...);
+        (mEntityManager.setSignatureBit<ComponentTs>(entity, false), ...);
+
+        if(mStorageMode == StorageMode::ARCHETYPE)
+            mArchetypeManager.removeComponents<ComponentTs...>(entity);
+        else
+            mComponentManager.removeComponents<ComponentTs...>(entity);
+    }
+
+    //Returns nullptr if the entity is dead or doesnt have a ComponentT.
+    template <typename ComponentT>
+    NonOwningPtr<ComponentT> getComponent(Entity const& entity)
+    {
+        if(!mEntityManager.isAlive(entity)) {return nullptr;}
+
+        if(mStorageMode == StorageMode::ARCHETYPE)
+            return mArchetypeManager.getComponent<ComponentT>(entity);
+
+        return mComponentManager.getComponent<ComponentT>(entity);
+    }
+
+    //Stamp the entity's ComponentT as changed, so that views filtered with changedSince<ComponentT>()
+    //pick it up. Safe to call from systems running in parallel, as long as they write ComponentT.
+    template <typename ComponentT>
+    void markChanged(Entity const& entity)
+    {
+        if(!mEntityManager.isAlive(entity)) {return;}
+
+        //Only journal the first mark of a tick, DeltaRecorder just needs to know it changed.
+        auto const tick {getChangeTick()};
+        auto const isFirstMark {mStorageMode == StorageMode::ARCHETYPE ?
+            mArchetypeManager.markChanged(entity, GetIDFromType<ComponentT>(), tick) :
+            mComponentManager.markChanged<ComponentT>(entity, tick)};
+        if(isFirstMark) {journal(entity, JournalOp::WRITE_COMPONENT, GetIDFromType<ComponentT>());}
+    }
+
+    //getComponent() and markChanged() in one go, for when the component is about to be written.
+    template <typename ComponentT>
+    NonOwningPtr<ComponentT> patch(Entity const& entity)
+    {
+        markChanged<ComponentT>(entity);
+        return getComponent<ComponentT>(entity);
+    }
+
+    //When the entity's ComponentT was added and last changed, or nullptr if it doesnt have one.
+    template <typename ComponentT>
+    NonOwningPtr<ComponentTicks const> getTicks(Entity const& entity)
+    {
+        if(!mEntityManager.isAlive(entity)) {return nullptr;}
+
+        if(mStorageMode == StorageMode::ARCHETYPE)
+            return mArchetypeManager.getTicks<ComponentT>(entity);
+
+        return mComponentManager.getTicks<ComponentT>(entity);
+    }
+
+    //Runtime versions of getComponent(), addComponents() and removeComponents() for when the
+    //component type is only known by ID (replaying recorded deltas, scripting).
+    //getComponentByID() returns nullptr if the entity is dead or doesnt have the component.
+    [[nodiscard]] void* getComponentByID(Entity const& entity, Index_t componentID)
+    {
+        if(!mEntityManager.isAlive(entity)) {return nullptr;}
+
+        if(mStorageMode == StorageMode::ARCHETYPE)
+            return mArchetypeManager.getComponentByID(entity, componentID);
+
+        auto* pool {mComponentManager.findPool(componentID)};
+        return pool ? pool->getRawComponent(entity) : nullptr;
+    }
+
+    //Copy value into the entity's component and mark it as changed,
+    //or add the component with value if the entity doesnt have one yet.
+    void setComponentByID(Entity const& entity, Index_t componentID, void const* value);
+    void removeComponentByID(Entity const& entity, Index_t componentID);
+
+    //Make exactly this entity handle alive again. See EntityManager::claimEntity().
+    bool restoreEntity(Entity const& entity);
+
+    //Calls fn(std::span<Entity const>, std::byte const* components) for every block of
+    //componentID, whichever the storage mode. components holds one component per entity.
+    template <typename Func>
+    void eachComponentByID(Index_t componentID, Func&& fn)
+    {
+        if(mStorageMode == StorageMode::ARCHETYPE)
+        {
+            mArchetypeManager.eachColumnByID(componentID, fn);
+            return;
+        }
+
+        auto* pool {mComponentManager.findPool(componentID)};
+        if(!pool) {return;}
+
+        for(size_t chunk = 0; chunk < pool->getChunkCount(); ++chunk)
+        {
+            if(auto const entities {pool->getEntityChunk(chunk)}; !entities.empty())
+                fn(entities, static_cast<std::byte const*>(pool->getRawComponentChunk(chunk)));
+        }
+    }
+
+    EntityManager const& getEntityManager() const {return mEntityManager;}
+
+    //While journaling is on, every entity created or destroyed, component added or removed,
+    //and markChanged() is logged, one journal per thread. DeltaRecorder turns them into deltas.
+    //Off by default. Only switch it at a sync point.
+    enum struct JournalOp : U8
+    {
+        CREATE_ENTITY,
+        DESTROY_ENTITY,
+        WRITE_COMPONENT,
+        REMOVE_COMPONENT
+    };
+
+    struct JournalEntry
+    {
+        Entity entity;
+        Index_t componentID;
+        JournalOp op;
+    };
+
+    void setJournaling(bool journaling) {mJournaling = journaling; clearJournal();}
+    bool isJournaling() const {return mJournaling;}
+
+    //Calls fn(JournalEntry const&) for every thread's entries. Structural changes only happen
+    //at sync points on one thread, so those all come out in the order they happened.
+    template <typename Func>
+    void eachJournalEntry(Func&& fn) const
+    {
+        for(auto const& threadJournal : mJournals)
+        {
+            for(auto const& entry : threadJournal)
+                fn(entry);
+        }
+    }
+
+    void clearJournal()
+    {
+        for(auto& threadJournal : mJournals)
+            threadJournal.clear();
+    }
+
+    //The tick that additions and changes are currently stamped with.
+    U32 getChangeTick() const {return mChangeTick.load(std::memory_order_relaxed);}
+
+    //Start a new tick and return the one that just ended. A reactive system calls this when
+    //it starts, and on its next run asks for whatever changed after the tick it got back:
+    //
+    //auto const since {std::exchange(mLastRun, ecs.advanceChangeTick())};
+    //ecs.view<Transform>().changedSince<Transform>(since).each(...);
+    //
+    //Nothing is missed or seen twice as long as the systems that write the component
+    //dont run at the same time as the reactive system, which SystemScheduler already ensures.
+    U32 advanceChangeTick() {return mChangeTick.fetch_add(1, std::memory_order_relaxed);}
+
+    //Calls fn(Entity) for every entity that lost its ComponentT (or was removed) after tick.
+    //The entity may be dead by now. Returns false if some of those removals were already
+    //trimmed out of the log, in which case the caller has to resync from scratch.
+    template <typename ComponentT, typename Func>
+    [[nodiscard]] bool eachRemovedSince(U32 tick, Func&& fn) const
+    {
+        auto const id {GetIDFromType<ComponentT>()};
+        auto const& log {mRemovedLogs[id]};
+
+        //The log is in tick order, so only the tail can be newer than tick.
+        auto it {log.end()};
+        while(it != log.begin() && std::prev(it)->tick > tick) {--it;}
+
+        for(; it != log.end(); ++it)
+            fn(it->entity);
+
+        return tick >= mTrimmedUpTo[id];
+    }
+
+    //Forget the removals stamped with tick or older. ApplicationBase does this
+    //once per frame with the tick the previous frame started at.
+    //Each log also trims its older half by itself once it holds sMaxRemovedLogSize removals,
+    //so worlds that never call this (tools, benchmarks) dont grow it forever.
+    void trimRemovedLogs(U32 tick);
+
+    inline constexpr static size_t sMaxRemovedLogSize{1 << 16};
+
+    //Query every entity that has all of ComponentTs. See View.hpp.
+    //ecs.view<Transform, Velocity>().without<Frozen>().each([](Entity e, Transform& t, Velocity& v){...});
+    template <typename ...ComponentTs>
+    [[nodiscard]] View<TypeList<ComponentTs...>> view()
+    {
+        return {mEntityManager, mComponentManager, mArchetypeManager,
+            mStorageMode == StorageMode::ARCHETYPE};
+    }
+
+    //The calling thread's command buffer. Record structural changes into it while iterating
+    //or from inside of systems running on worker threads, and they are applied at the next flushCommands().
+    CommandBuffer& getCommandBuffer()
+    {
+        return mCommandBuffers[ThreadPool::get().getCurrentThreadIndex()];
+    }
+
+    //Apply every thread's recorded commands. Call this from one thread at a sync point
+    //where nothing is iterating (ApplicationBase does it after the systems have run).
+    //Pending entities are created first, then the rest of the commands are applied sorted
+    //by entity so storage is touched in order. The commands for any one entity keep the
+    //order they were recorded in. Commands recorded by event listeners while flushing are
+    //applied too, in another pass after the current one.
+    void flushCommands();
+
+    //Subscribe to EntityCreatedEvent, ComponentAddedEvent etc. here. See ECSEvents.hpp.
+    //ApplicationBase drains the queued events once per frame after flushCommands().
+    ECSEventBus& getEventBus() {return mEventBus;}
+
+    //Remove every entity, sending the usual EntityDestroyedEvents.
+    void clear();
+
+    //Write every entity and component to a flat binary file. See ECSSnapshot.hpp for the layout.
+    MaybeError saveSnapshot(std::filesystem::path const& path);
+
+    //Replace every entity with the ones in a snapshot file written by saveSnapshot().
+    //The file is mapped into memory and its component blocks are copied straight into storage.
+    //Loaded components are stamped as added at the current change tick, but no created
+    //or added events are sent. Components whose type hasnt been registered yet in this
+    //program are dropped, so register game components before loading a level.
+    //Like flushCommands(), call this at a sync point. The world is left alone if the file is bad.
+    MaybeError loadSnapshot(std::filesystem::path const& path);
+
+    //The same, from a snapshot that is already in memory.
+    MaybeError loadSnapshot(std::span<std::byte const> bytes);
+
+    //Shorthand for view<ComponentTs...>().parallelEach(fn, grainSize, mode). See View.hpp.
+    template <typename ...ComponentTs, typename Func>
+    size_t parallelEach(Func&& fn, size_t grainSize = 1024, ParallelMode mode = ParallelMode::FAST)
+    {
+        return view<ComponentTs...>().parallelEach(std::forward<Func>(fn), grainSize, mode);
     }
 
 private:
     
-    ECS()=default;
+    ECS();
     ~ECS()=default;
 
     ECS(const ECS&)=delete;
@@ -65,9 +374,78 @@ private:
     ECS& operator=(ECS const&)=delete;
     ECS& operator=(ECS&&)=delete;
 
+    StorageMode mStorageMode{StorageMode::SPARSE_SET};
     EntityManager mEntityManager;
     ComponentManager mComponentManager;
+    ArchetypeManager mArchetypeManager;
     ECSEventBus mEventBus;
+
+    //Starts at 1 so that a reactive system that hasnt run yet (last tick 0) sees everything.
+    std::atomic<U32> mChangeTick{1};
+
+    struct RemovedComponent
+    {
+        Entity entity;
+        U32 tick;
+    };
+
+    //One log per component type. Removing happens at sync points, so this doesnt need a lock.
+    std::array<std::vector<RemovedComponent>, MAX_NUM_COMPONENT_TYPES> mRemovedLogs;
+
+    //The newest tick trimmed out of each log. Readers asking for removals
+    //after an older tick than this have missed some.
+    std::array<U32, MAX_NUM_COMPONENT_TYPES> mTrimmedUpTo{};
+
+    void logRemovals(Entity const& entity, Signature_t const& removed)
+    {
+        if(removed.none()) {return;}
+
+        auto const tick {getChangeTick()};
+        for(size_t id = 0; id < MAX_NUM_COMPONENT_TYPES; ++id)
+        {
+            if(!removed.test(id)) {continue;}
+
+            auto& log {mRemovedLogs[id]};
+            if(log.size() == sMaxRemovedLogSize) {trimRemovedLog(id, log[log.size() / 2].tick);}
+            log.push_back({entity, tick});
+        }
+    }
+
+    void trimRemovedLog(size_t componentID, U32 tick);
+
+    //One per ThreadPool thread index.
+    std::vector<CommandBuffer> mCommandBuffers;
+
+    //flushCommands() swaps these with mCommandBuffers and applies them, so listeners can
+    //record new commands without touching the ones being applied.
+    std::vector<CommandBuffer> mFlushBuffers;
+
+    //Flushing stops after this many passes and leaves the rest for the next flushCommands(),
+    //in case listeners keep recording commands in response to each other.
+    inline constexpr static U32 sMaxFlushPasses{16};
+
+    void applyCommands(std::vector<CommandBuffer> const& buffers);
+
+    bool mJournaling{false};
+
+    //One per ThreadPool thread index, like the command buffers.
+    std::vector<std::vector<JournalEntry>> mJournals;
+
+    void journal(Entity const& entity, JournalOp op, Index_t componentID = 0)
+    {
+        if(mJournaling)
+            mJournals[ThreadPool::get().getCurrentThreadIndex()].push_back({entity, componentID, op});
+    }
+
+    //Reused by flushCommands() so flushing doesnt allocate once it has warmed up.
+    struct PendingCommand
+    {
+        Entity entity;
+        CommandBuffer::Command const* command;
+        void const* payload;
+    };
+    std::vector<PendingCommand> mFlushScratch;
+    std::vector<Entity> mCreatedEntities;
 };
 
-}
\ No newline at end of file
+}
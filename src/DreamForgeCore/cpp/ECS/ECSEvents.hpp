@@ -1,35 +1,220 @@
 #pragma once
 #include <vector>
+#include <array>
+#include <tuple>
+#include <algorithm>
 #include "BiDirectionalTypeIntMap.hpp"
+#include "EntityManager.hpp"
 
-struct ECSEvent
+namespace DF
 {
-    
+
+struct EntityCreatedEvent
+{
+    Entity entity;
+};
+
+struct EntityDestroyedEvent
+{
+    Entity entity;
 };
 
+struct ComponentAddedEvent
+{
+    Entity entity;
+    Index_t componentID{};
+};
+
+struct ComponentRemovedEvent
+{
+    Entity entity;
+    Index_t componentID{};
+};
+
+//Sent the first time a component is marked as changed in a change tick (see ECS::markChanged()).
+//markChanged() runs inside of parallel systems, so this one is always queued and arrives at drain().
+struct ComponentChangedEvent
+{
+    Entity entity;
+    Index_t componentID{};
+};
+
+//Event types are a closed set owned by the ECS, so unlike components they get compile time IDs.
+//Remeber to update the macro when you add and remove event types.
+#define ECS_EVENT_TYPES \
+    EntityCreatedEvent, \
+    EntityDestroyedEvent, \
+    ComponentAddedEvent, \
+    ComponentRemovedEvent
+
+#define ECS_EVENT_REGISTRY TypeRegistry<ECS_EVENT_TYPES>
+
+//Get the ID mapped to EventT.
+template <typename EventT>
+inline constexpr Index_t GetEventID = ECS_EVENT_REGISTRY::IndexedMap::index<EventT>;
+
+inline constexpr auto NUM_ECS_EVENT_TYPES = ECS_EVENT_REGISTRY::sNumTypes;
+
+//Every event type has its own list of listeners, indexed by its compile time ID,
+//so notify<EventT>() only ever touches EventT's listeners.
+//
+//A listener is a function pointer plus an optional context pointer, so stateful
+//listeners (member functions, functors) never need a heap allocated closure. The
+//bus does not own the context, so unsubscribe before it is destroyed.
+//
+//Events can also be queued with enqueue() and dispatched in a batch by drain(),
+//once per frame. The queues are typed vectors that keep their capacity between frames.
 class ECSEventBus
 {
 public:
-    using NotifyFuncT = void (*)(const ECSEvent&);
+
+    //Returned by subscribe so the same listener can be unsubscribed later.
+    struct Listener
+    {
+        void* context{nullptr};
+        void (*thunk)(void* context, void const* evnt){nullptr};
+
+        bool operator==(Listener const&) const=default;
+    };
+
+    //Listeners can subscribe and unsubscribe from inside of a listener. The ones subscribed
+    //while an event is being sent only get the next one, and unsubscribed ones get no more.
+    template <typename EventT>
+    void notify(EventT const& evnt)
+    {
+        DispatchScope const scope {*this};
+
+        //Indexed, and only up to the listeners there were to begin with, since subscribing can reallocate.
+        auto const& listeners {mListeners[GetEventID<EventT>]};
+        for(size_t i = 0, count = listeners.size(); i < count; ++i)
+        {
+            auto const listener {listeners[i]};
+            if(listener.thunk) {listener.thunk(listener.context, &evnt);}
+        }
+    }
+
+    template <typename EventT>
+    bool hasListeners() const {return !mListeners[GetEventID<EventT>].empty();}
+
+    //A free function or captureless lambda. Free functions dont have a context,
+    //so the function pointer itself is smuggled through the context pointer.
+    template <typename EventT>
+    Listener subscribe(void (*fn)(EventT const&))
+    {
+        return addListener<EventT>({
+            .context = reinterpret_cast<void*>(fn),
+            .thunk = [](void* ctx, void const* evnt)
+            {
+                reinterpret_cast<void(*)(EventT const&)>(ctx)(*static_cast<EventT const*>(evnt));
+            }
+        });
+    }
+
+    //A member function called on instance: subscribe<EventT, &Class::onEvent>(this)
+    template <typename EventT, auto MemberFn, typename ClassT>
+    Listener subscribe(ClassT* instance)
+    {
+        return addListener<EventT>({
+            .context = instance,
+            .thunk = [](void* ctx, void const* evnt)
+            {
+                (static_cast<ClassT*>(ctx)->*MemberFn)(*static_cast<EventT const*>(evnt));
+            }
+        });
+    }
+
+    //Any callable object, called through a pointer to it.
+    template <typename EventT, typename FunctorT>
+    Listener subscribe(FunctorT& functor)
+    {
+        return addListener<EventT>({
+            .context = &functor,
+            .thunk = [](void* ctx, void const* evnt)
+            {
+                (*static_cast<FunctorT*>(ctx))(*static_cast<EventT const*>(evnt));
+            }
+        });
+    }
 
     template <typename EventT>
-    void notify(const EventT& evnt)
+    void unsubscribe(Listener const& listener)
     {
-        const auto& funcs = mNotifyFuncTable[0];
+        auto& listeners {mListeners[GetEventID<EventT>]};
+        if(mDispatchDepth == 0)
+        {
+            std::erase(listeners, listener);
+            return;
+        }
 
-        for(const auto func : funcs)
+        //Erasing would shift the listeners under a notify() that is still walking them,
+        //so blank it out and leave the erasing for when the last notify() is done.
+        if(auto it {std::ranges::find(listeners, listener)}; it != listeners.end())
         {
-            func(evnt);
+            *it = Listener{};
+            mHasBlankListeners = true;
         }
     }
 
+    //Queue the event to be dispatched by the next drain() instead of right now.
     template <typename EventT>
-    void subscribe(NotifyFuncT fn)
+    void enqueue(EventT const& evnt)
     {
-        mNotifyFuncTable[0].push_back(fn);
+        std::get<std::vector<EventT>>(mQueues).push_back(evnt);
+    }
+
+    //Dispatch every queued event, one event type at a time, in the order they were queued.
+    void drain()
+    {
+        std::apply([this](auto&... queues){(drainQueue(queues), ...);}, mQueues);
     }
 
 private:
-    std::vector<std::vector<NotifyFuncT>> mNotifyFuncTable;
 
-};
\ No newline at end of file
+    //Counts the notify() calls in progress, which can nest when listeners send events.
+    struct DispatchScope
+    {
+        explicit DispatchScope(ECSEventBus& bus) : mBus{bus} {++mBus.mDispatchDepth;}
+        ~DispatchScope()
+        {
+            if(--mBus.mDispatchDepth == 0 && mBus.mHasBlankListeners) {mBus.eraseBlankListeners();}
+        }
+
+        ECSEventBus& mBus;
+    };
+
+    void eraseBlankListeners()
+    {
+        for(auto& listeners : mListeners)
+            std::erase(listeners, Listener{});
+        mHasBlankListeners = false;
+    }
+
+    template <typename EventT>
+    Listener addListener(Listener listener)
+    {
+        mListeners[GetEventID<EventT>].push_back(listener);
+        return listener;
+    }
+
+    template <typename EventT>
+    void drainQueue(std::vector<EventT>& queue)
+    {
+        //Indexed since listeners are allowed to enqueue more events of the same type.
+        for(size_t i = 0; i < queue.size(); ++i)
+        {
+            auto const evnt {queue[i]};
+            notify(evnt);
+        }
+        queue.clear();
+    }
+
+    template <typename ...EventTs>
+    using EventQueues = std::tuple<std::vector<EventTs>...>;
+
+    std::array<std::vector<Listener>, NUM_ECS_EVENT_TYPES> mListeners;
+    U32 mDispatchDepth{0};
+    bool mHasBlankListeners{false};
+    EventQueues<ECS_EVENT_TYPES> mQueues;
+};
+
+}
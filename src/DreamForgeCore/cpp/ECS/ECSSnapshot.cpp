@@ -0,0 +1,306 @@
+#include "ECSSnapshot.hpp"
+#include "ECS.hpp"
+#include "MappedFile.hpp"
+#include <fstream>
+#include <cstring>
+#include <string_view>
+#include <cstdint>
+
+namespace DF
+{
+
+static U64 alignUp(U64 offset, U64 alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+void writeSnapshot(EntityManager const& entities, SnapshotComponentSource const& eachComponent, SnapshotSink const& write)
+{
+    auto const& registry {ComponentRegistry::get()};
+
+    U64 written {0};
+    auto const writeBytes {[&write, &written](void const* data, U64 size)
+    {
+        write(data, size);
+        written += size;
+    }};
+
+    auto const padTo {[&writeBytes, &written](U64 offset)
+    {
+        static constexpr std::array<std::byte, sSnapshotBlockAlignment> zeros{};
+        writeBytes(zeros.data(), offset - written);
+    }};
+
+    //Only the component types that some entity has get a pool in the file.
+    std::vector<Index_t> poolIDs;
+    std::vector<SnapshotPool> pools;
+
+    for(Index_t id = 0; id < registry.getComponentCount(); ++id)
+    {
+        U64 count {0};
+        eachComponent(id, [&count](std::span<Entity const> owners, std::byte const*){count += owners.size();});
+
+        if(count == 0) {continue;}
+
+        poolIDs.push_back(id);
+        pools.push_back({.nameLength = static_cast<U32>(registry.getInfo(id).name.size()),
+            .componentSize = static_cast<U32>(registry.getInfo(id).size), .count = count});
+    }
+
+    //Lay out the whole file up front so it can be written front to back.
+    SnapshotHeader header
+    {
+        .slotCount = entities.getSlotCount(),
+        .freeListHead = entities.getFreeListHead(),
+        .entityCount = entities.getCurrentEntityCount(),
+        .poolCount = static_cast<U32>(pools.size())
+    };
+
+    header.slotsOffset = alignUp(sizeof(SnapshotHeader), sSnapshotBlockAlignment);
+    header.poolsOffset = alignUp(header.slotsOffset + header.slotCount * sizeof(SnapshotSlot), sSnapshotBlockAlignment);
+
+    U64 offset {header.poolsOffset + pools.size() * sizeof(SnapshotPool)};
+    for(auto& pool : pools)
+    {
+        pool.nameOffset = offset;
+        offset += pool.nameLength;
+    }
+
+    for(auto& pool : pools)
+    {
+        pool.entitiesOffset = alignUp(offset, sSnapshotBlockAlignment);
+        pool.componentsOffset = alignUp(pool.entitiesOffset + pool.count * sizeof(Entity), sSnapshotBlockAlignment);
+        offset = pool.componentsOffset + pool.count * pool.componentSize;
+    }
+
+    writeBytes(&header, sizeof(header));
+
+    //The slot table, with the signatures translated to pool table indices.
+    padTo(header.slotsOffset);
+    std::vector<SnapshotSlot> slots(header.slotCount);
+    for(U32 idx = 0; idx < header.slotCount; ++idx)
+    {
+        auto const state {entities.getSlotState(idx)};
+        auto const& signature {entities.getSignature(Entity{idx, state.generation})};
+
+        slots[idx] = {.generation = state.generation, .nextFree = state.nextFree};
+        for(size_t i = 0; i < poolIDs.size(); ++i)
+        {
+            if(signature.test(poolIDs[i])) {slots[idx].signature |= U64{1} << i;}
+        }
+    }
+    writeBytes(slots.data(), slots.size() * sizeof(SnapshotSlot));
+
+    padTo(header.poolsOffset);
+    writeBytes(pools.data(), pools.size() * sizeof(SnapshotPool));
+    for(auto const id : poolIDs)
+    {
+        auto const& name {registry.getInfo(id).name};
+        writeBytes(name.data(), name.size());
+    }
+
+    for(size_t i = 0; i < pools.size(); ++i)
+    {
+        auto const componentSize {pools[i].componentSize};
+
+        padTo(pools[i].entitiesOffset);
+        eachComponent(poolIDs[i], [&writeBytes](std::span<Entity const> owners, std::byte const*)
+        {
+            writeBytes(owners.data(), owners.size_bytes());
+        });
+
+        padTo(pools[i].componentsOffset);
+        eachComponent(poolIDs[i], [&writeBytes, componentSize](std::span<Entity const> owners, std::byte const* components)
+        {
+            writeBytes(components, owners.size() * componentSize);
+        });
+    }
+}
+
+MaybeError ECS::saveSnapshot(std::filesystem::path const& path)
+{
+    std::ofstream out {path, std::ios::binary | std::ios::trunc};
+    if(!out)
+        return Error{Error::Code::COULD_NOT_OPEN_FILE};
+
+    writeSnapshot(mEntityManager,
+        [this](Index_t id, SnapshotBlockFn const& fn){eachComponentByID(id, fn);},
+        [&out](void const* data, size_t size){out.write(static_cast<char const*>(data), static_cast<std::streamsize>(size));});
+
+    if(!out)
+        return Error{Error::Code::COULD_NOT_OPEN_FILE};
+
+    return std::nullopt;
+}
+
+//Everything is checked before the world is touched, so a bad file can be rejected cleanly.
+static bool isInFile(std::span<std::byte const> bytes, U64 offset, U64 size)
+{
+    return offset <= bytes.size() && size <= bytes.size() - offset;
+}
+
+MaybeError ECS::loadSnapshot(std::filesystem::path const& path)
+{
+    auto maybeFile {MappedFile::open(path)};
+    if(!maybeFile)
+    {
+        Logger::get().fmtStdoutError("could not open snapshot {}", path.string());
+        return maybeFile.error();
+    }
+
+    return loadSnapshot(maybeFile->getBytes());
+}
+
+MaybeError ECS::loadSnapshot(std::span<std::byte const> bytes)
+{
+    auto const invalid {[](std::string_view reason) -> MaybeError
+    {
+        Logger::get().fmtStdoutError("could not load snapshot: {}", reason);
+        return Error{Error::Code::INVALID_SNAPSHOT};
+    }};
+
+    SnapshotHeader header;
+    if(!isInFile(bytes, 0, sizeof(header)))
+        return invalid("the file is too small");
+
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if(header.magic != sSnapshotMagic || header.version != sSnapshotVersion)
+        return invalid("not a snapshot or written by a different version");
+
+    if(header.poolCount > MAX_NUM_COMPONENT_TYPES || header.entityCount > header.slotCount ||
+        header.slotsOffset % alignof(SnapshotSlot) != 0 || header.poolsOffset % alignof(SnapshotPool) != 0 ||
+        !isInFile(bytes, header.slotsOffset, U64{header.slotCount} * sizeof(SnapshotSlot)) ||
+        !isInFile(bytes, header.poolsOffset, U64{header.poolCount} * sizeof(SnapshotPool)))
+    {
+        return invalid("the header is corrupt");
+    }
+
+    //The blocks are aligned in the file and mappings start on a page, so they can be read in place.
+    //Snapshots already in memory have to be at least 8 byte aligned.
+    if(reinterpret_cast<std::uintptr_t>(bytes.data()) % alignof(U64) != 0)
+        return invalid("the snapshot isnt aligned in memory");
+
+    auto const* slots {reinterpret_cast<SnapshotSlot const*>(bytes.data() + header.slotsOffset)};
+    auto const* pools {reinterpret_cast<SnapshotPool const*>(bytes.data() + header.poolsOffset)};
+    auto const& registry {ComponentRegistry::get()};
+
+    //Pool table index to component ID in this program, or MAX_NUM_COMPONENT_TYPES to drop the pool.
+    std::array<Index_t, MAX_NUM_COMPONENT_TYPES> idOf{};
+    for(U32 i = 0; i < header.poolCount; ++i)
+    {
+        auto const& pool {pools[i]};
+        if(pool.count > bytes.size() || pool.componentSize > bytes.size() ||
+            !isInFile(bytes, pool.nameOffset, pool.nameLength) ||
+            !isInFile(bytes, pool.entitiesOffset, pool.count * sizeof(Entity)) ||
+            !isInFile(bytes, pool.componentsOffset, pool.count * pool.componentSize) ||
+            pool.entitiesOffset % alignof(Entity) != 0 || pool.componentsOffset % sSnapshotBlockAlignment != 0)
+        {
+            return invalid("the pool table is corrupt");
+        }
+
+        std::string_view const name {reinterpret_cast<char const*>(bytes.data() + pool.nameOffset), pool.nameLength};
+        idOf[i] = registry.findID(name);
+
+        if(idOf[i] == MAX_NUM_COMPONENT_TYPES)
+            Logger::get().fmtStdoutWarn("snapshot component {} is not registered, it will be dropped", name);
+        else if(registry.getInfo(idOf[i]).size != pool.componentSize)
+        {
+            Logger::get().fmtStdoutWarn("snapshot component {} changed size, it will be dropped", name);
+            idOf[i] = MAX_NUM_COMPONENT_TYPES;
+        }
+    }
+
+    //Every pool entity has to be alive with the pool's bit set in its signature,
+    //and the pool has to have as many entities as there are signatures with that bit.
+    std::array<U64, MAX_NUM_COMPONENT_TYPES> bitCounts{};
+    for(U32 idx = 0; idx < header.slotCount; ++idx)
+    {
+        if(slots[idx].generation == 0 || (header.poolCount < 64 && slots[idx].signature >> header.poolCount != 0))
+            return invalid("the slot table is corrupt");
+
+        for(U32 i = 0; i < header.poolCount; ++i)
+            bitCounts[i] += (slots[idx].signature >> i) & 1;
+    }
+
+    //The free list decides which slots are alive, so it has to stay in the table, have no loops,
+    //leave entityCount slots off of it, and only hold slots without components.
+    U64 freeCount {0};
+    for(auto idx {header.freeListHead}; idx != ~U32{0}; idx = slots[idx].nextFree)
+    {
+        if(idx >= header.slotCount || ++freeCount > header.slotCount || slots[idx].signature != 0)
+            return invalid("the free list is corrupt");
+    }
+
+    if(freeCount != header.slotCount - header.entityCount)
+        return invalid("the free list is corrupt");
+
+    for(U32 i = 0; i < header.poolCount; ++i)
+    {
+        if(bitCounts[i] != pools[i].count)
+            return invalid("a pool doesnt match the slot table");
+
+        auto const* entities {reinterpret_cast<Entity const*>(bytes.data() + pools[i].entitiesOffset)};
+        for(U64 row = 0; row < pools[i].count; ++row)
+        {
+            auto const idx {entities[row].getIndex()};
+            if(idx >= header.slotCount || slots[idx].generation != entities[row].getGeneration() ||
+                !((slots[idx].signature >> i) & 1))
+            {
+                return invalid("a pool doesnt match the slot table");
+            }
+        }
+    }
+
+    clear();
+
+    auto const toSignature {[&idOf, &header](U64 fileSignature)
+    {
+        Signature_t signature;
+        for(U32 i = 0; i < header.poolCount; ++i)
+        {
+            if((fileSignature >> i) & 1 && idOf[i] != MAX_NUM_COMPONENT_TYPES) {signature.set(idOf[i]);}
+        }
+        return signature;
+    }};
+
+    mEntityManager.resetSlots(header.slotCount, header.freeListHead, header.entityCount);
+    for(U32 idx = 0; idx < header.slotCount; ++idx)
+        mEntityManager.restoreSlot(idx, {slots[idx].generation, slots[idx].nextFree}, toSignature(slots[idx].signature));
+    mEntityManager.relinkFreeList();
+
+    auto const tick {getChangeTick()};
+
+    if(mStorageMode == StorageMode::ARCHETYPE)
+    {
+        //Put every entity straight into its final archetype, then fill in the rows.
+        //Free slots have no signature, so they are skipped.
+        for(U32 idx = 0; idx < header.slotCount; ++idx)
+        {
+            auto const entity {Entity{idx, slots[idx].generation}};
+            if(auto const signature {mEntityManager.getSignature(entity)}; signature.any())
+                mArchetypeManager.setSignature(entity, signature, tick);
+        }
+    }
+
+    for(U32 i = 0; i < header.poolCount; ++i)
+    {
+        auto const id {idOf[i]};
+        if(id == MAX_NUM_COMPONENT_TYPES) {continue;}
+
+        std::span const entities {reinterpret_cast<Entity const*>(bytes.data() + pools[i].entitiesOffset), pools[i].count};
+        auto const* components {bytes.data() + pools[i].componentsOffset};
+
+        if(mStorageMode == StorageMode::ARCHETYPE)
+        {
+            auto const size {pools[i].componentSize};
+            for(size_t row = 0; row < entities.size(); ++row)
+                std::memcpy(mArchetypeManager.getComponentByID(entities[row], id), components + row * size, size);
+        }
+        else
+            mComponentManager.getPool(id).insertRaw(entities, components, tick);
+    }
+
+    return std::nullopt;
+}
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <array>
+#include <type_traits>
+#include <functional>
+#include <span>
+#include <cstddef>
+#include "HelpfulTypeAliases.hpp"
+#include "Entity.hpp"
+#include "EntityManager.hpp"
+
+namespace DF
+{
+
+//The on disk layout of the files written by ECS::saveSnapshot().
+//
+//[SnapshotHeader][SnapshotSlot x slotCount][SnapshotPool x poolCount][component names]
+//then for every pool [Entity x count][component x count]
+//
+//Every block starts at a multiple of sSnapshotBlockAlignment, so once the file is mapped
+//into memory the blocks can be memcpy'd straight into the component arrays without any parsing.
+//The slot table is saved as is, free list included, so entities come back with the same
+//index and generation and the handles stored inside of components (Hierarchy::parent) stay valid.
+//
+//Components are matched up with the running program by their ComponentRegistry name,
+//since IDs depend on the order types were registered in. Signature bits in the file
+//index into the pool table, not into the registry.
+//Snapshots are native endian and are meant to be loaded by the same build that wrote them.
+
+inline constexpr std::array<char, 4> sSnapshotMagic {'D', 'F', 'S', 'N'};
+inline constexpr U32 sSnapshotVersion {1};
+inline constexpr U64 sSnapshotBlockAlignment {64};
+
+struct SnapshotHeader
+{
+    std::array<char, 4> magic{sSnapshotMagic};
+    U32 version{sSnapshotVersion};
+
+    //EntityManager state.
+    U32 slotCount{0};
+    U32 freeListHead{0};
+    U64 entityCount{0};
+
+    U32 poolCount{0};
+    U32 padding{0};
+
+    //Byte offsets from the start of the file.
+    U64 slotsOffset{0};
+    U64 poolsOffset{0};
+};
+
+struct SnapshotSlot
+{
+    U32 generation{0};
+    U32 nextFree{0};
+    U64 signature{0};
+};
+
+struct SnapshotPool
+{
+    U64 nameOffset{0};
+    U32 nameLength{0};
+
+    //Checked against the ComponentRegistry on load, so a component
+    //that changed size since the snapshot was written is caught.
+    U32 componentSize{0};
+
+    U64 count{0};
+    U64 entitiesOffset{0};
+    U64 componentsOffset{0};
+};
+
+//Writes a snapshot of the slot table of entities and the components handed out by eachComponent.
+//eachComponent(id, fn) has to call fn(std::span<Entity const> owners, std::byte const* components)
+//for every block of component id it has, the same way every time it is called.
+//ECS::saveSnapshot() hands it the live world, DeltaRecorder a copy of an older one.
+using SnapshotBlockFn = std::function<void(std::span<Entity const>, std::byte const*)>;
+using SnapshotComponentSource = std::function<void(Index_t, SnapshotBlockFn const&)>;
+using SnapshotSink = std::function<void(void const* data, size_t size)>;
+
+void writeSnapshot(EntityManager const& entities, SnapshotComponentSource const& eachComponent, SnapshotSink const& write);
+
+static_assert(std::is_trivially_copyable_v<Entity> && sizeof(Entity) == sizeof(U64),
+    "entity blocks are read straight out of the mapped file");
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "HelpfulTypeAliases.hpp"
+
+namespace DF
+{
+
+//A generational handle to an entity. The low 32 bits of the ID are the index of
+//the entity's slot in the EntityManager and the high 32 bits are the generation of that
+//slot when the entity was made. When an entity is removed its slot's generation is
+//bumped, so old copies of the handle stop being alive even after the slot is recycled.
+//A default constructed Entity is a null handle (generations start at 1).
+class Entity
+{
+public:
+    Entity()=default;
+    Entity(U32 index, U32 generation)
+        : m_entityID{static_cast<U64>(generation) << 32 | index} {}
+
+    auto getID() const {return m_entityID;}
+    U32 getIndex() const {return static_cast<U32>(m_entityID);}
+    U32 getGeneration() const {return static_cast<U32>(m_entityID >> 32);}
+    bool isNull() const {return getGeneration() == 0;}
+
+    bool operator==(Entity const&) const=default;
+
+private:
+    U64 m_entityID{0};
+};
+
+}
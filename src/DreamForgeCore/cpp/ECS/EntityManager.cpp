@@ -2,30 +2,134 @@
 #include "errorHandling.hpp"
 #include "Logging.hpp"
 #include <cassert>
+#include <algorithm>
 
 namespace DF {
 
+EntityManager::EntityManager(size_t initialReservation)
+{
+    mSlots.reserve(initialReservation);
+}
+
 Expect<Entity> EntityManager::makeEntity()
 {
     //If we are already at maximum entities.
     if(haveReachedMaxEntities())
         return std::unexpected(Error::Code::MAX_ENTITIES_REACHED);
 
-    mEntities[mCurrentEntityCount].setID(mCurrentEntityCount++);
+    //Recycle a removed slot if there is one, otherwise take a fresh one.
+    U32 idx{mFreeListHead};
+    if(idx != sEndOfFreeList)
+        unlinkFree(idx);
+    else
+    {
+        idx = mNumSlotsUsed++;
+        mSlots.reserve(mNumSlotsUsed);
+    }
+
+    mSlots[idx].isAlive = true;
+    ++mCurrentEntityCount;
 
     //If we have reached maximum entities after making this one.
     if(haveReachedMaxEntities())
     {
         Logger::get().fmtStdoutWarn("max entites reached {}/{}",
-            mCurrentEntityCount, mCurrentEntityCount);
+            mCurrentEntityCount, getMaxEntityCount());
+    }
+
+    return Entity{idx, mSlots[idx].generation};
+}
+
+bool EntityManager::claimEntity(Entity const& entity)
+{
+    if(entity.isNull() || haveReachedMaxEntities())
+        return false;
+
+    auto const idx {entity.getIndex()};
+    if(idx < mNumSlotsUsed)
+    {
+        if(mSlots[idx].isAlive || entity.getGeneration() < mSlots[idx].generation)
+            return false;
+
+        unlinkFree(idx);
+    }
+    else
+    {
+        //Any fresh slots that get skipped over go on the free list, lowest index first.
+        mSlots.reserve(static_cast<size_t>(idx) + 1);
+        for(auto skipped {idx}; skipped-- > mNumSlotsUsed;)
+            pushFree(skipped);
+        mNumSlotsUsed = idx + 1;
+    }
+
+    mSlots[idx].generation = entity.getGeneration();
+    mSlots[idx].isAlive = true;
+    ++mCurrentEntityCount;
+    return true;
+}
+
+void EntityManager::removeEntity(Entity const& entity)
+{
+    if(!isAlive(entity))
+    {
+        Logger::get().stdoutError("EntityManager::removeEntity() called with a dead entity");
+        return;
+    }
+
+    auto& slot {mSlots[entity.getIndex()]};
+
+    //Bump the generation so any handles still pointing at this slot go stale.
+    //Generation 0 is reserved for null handles, so skip it on wrap around.
+    if(++slot.generation == 0) {slot.generation = 1;}
+
+    slot.signature.reset();
+    slot.isAlive = false;
+    pushFree(entity.getIndex());
+
+    --mCurrentEntityCount;
+}
+
+void EntityManager::resetSlots(U32 slotCount, U32 freeListHead, size_t entityCount)
+{
+    mSlots = {};
+    mSlots.reserve(std::max<size_t>(slotCount, sDefaultReservation));
+    mNumSlotsUsed = slotCount;
+    mFreeListHead = freeListHead;
+    mCurrentEntityCount = entityCount;
+}
+
+void EntityManager::relinkFreeList()
+{
+    for(U32 idx = 0; idx < mNumSlotsUsed; ++idx)
+        mSlots[idx].isAlive = true;
+
+    auto prev {sEndOfFreeList};
+    for(auto idx {mFreeListHead}; idx != sEndOfFreeList; idx = mSlots[idx].nextFree)
+    {
+        mSlots[idx].isAlive = false;
+        mSlots[idx].prevFree = prev;
+        prev = idx;
     }
+}
+
+void EntityManager::unlinkFree(U32 idx)
+{
+    auto& slot {mSlots[idx]};
+    if(slot.prevFree != sEndOfFreeList) {mSlots[slot.prevFree].nextFree = slot.nextFree;}
+    else {mFreeListHead = slot.nextFree;}
 
-    return mEntities[mCurrentEntityCount];
+    if(slot.nextFree != sEndOfFreeList) {mSlots[slot.nextFree].prevFree = slot.prevFree;}
+
+    slot.nextFree = sEndOfFreeList;
+    slot.prevFree = sEndOfFreeList;
 }
 
-void EntityManager::removeEntity()
+void EntityManager::pushFree(U32 idx)
 {
-    
+    mSlots[idx].prevFree = sEndOfFreeList;
+    mSlots[idx].nextFree = mFreeListHead;
+    if(mFreeListHead != sEndOfFreeList) {mSlots[mFreeListHead].prevFree = idx;}
+    mFreeListHead = idx;
 }
 
-}
\ No newline at end of file
+}
@@ -2,35 +2,22 @@
 #include <array>
 #include <cstdint>
 #include <bitset>
+#include <vector>
 #include "Components.hpp"
 #include "errorHandling.hpp"
 #include "HelpfulTypeAliases.hpp"
+#include "ChunkedArray.hpp"
+#include "Entity.hpp"
 
 namespace DF
 {
 
-class Entity
-{
-public:
-
-    template <typename T> 
-    void setSignature()
-    {
-        m_signature.set(GetIDFromType<T>);
-    }
-
-    void zeroSignatureBits() {m_signature.reset();}
-    auto getID() const {return m_entityID;}
-    void setID(U64 id) {m_entityID = id;}
-private:
-    U64 m_entityID{0};
-    std::bitset<64> m_signature{};
-};
-
 class EntityManager
 {
 public:
-    EntityManager()=default;
+    //initialReservation entity slots are allocated up front. More are
+    //allocated in chunks as needed, so this is a hint and not a limit.
+    explicit EntityManager(size_t initialReservation = sDefaultReservation);
     ~EntityManager()=default;
 
     EntityManager(EntityManager const&)=delete;
@@ -43,12 +30,112 @@ public:
     inline auto haveReachedMaxEntities() const {return mCurrentEntityCount >= getMaxEntityCount();}
     [[nodiscard("dont forget your entity")]] Expect<Entity> makeEntity();
 
-    void removeEntity();
+    //Make room for at least entityCount entities without further allocation.
+    void reserve(size_t entityCount) {mSlots.reserve(entityCount);}
+    auto getCapacity() const {return mSlots.getCapacity();}
+
+    //Make exactly this entity alive again, e.g. to replay a recorded CREATE_ENTITY. O(1).
+    //Returns false if its slot is in use, or if the slot has already handed out a newer
+    //generation, since claiming an older one would bring stale handles back to life.
+    bool claimEntity(Entity const& entity);
+
+    //Recycles the entity's slot. Does nothing if the entity is not alive.
+    void removeEntity(Entity const& entity);
+
+    //O(1). False for null handles, removed entities and stale handles to recycled slots.
+    bool isAlive(Entity const& entity) const
+    {
+        return entity.getIndex() < mNumSlotsUsed && mSlots[entity.getIndex()].isAlive &&
+            mSlots[entity.getIndex()].generation == entity.getGeneration();
+    }
+
+    //The signature lives with the slot instead of the handle,
+    //since handles are copied around by value.
+    template <typename ComponentT>
+    void setSignatureBit(Entity const& entity, bool value = true)
+    {
+        mSlots[entity.getIndex()].signature.set(GetIDFromType<ComponentT>(), value);
+    }
+
+    void setSignatureBit(Entity const& entity, Index_t componentID, bool value = true)
+    {
+        mSlots[entity.getIndex()].signature.set(componentID, value);
+    }
+
+    Signature_t const& getSignature(Entity const& entity) const
+    {
+        return mSlots[entity.getIndex()].signature;
+    }
+
+    //Calls fn(Entity) for every alive entity, in slot order.
+    template <typename Func>
+    void eachAlive(Func&& fn) const
+    {
+        for(U32 idx = 0; idx < mNumSlotsUsed; ++idx)
+        {
+            if(mSlots[idx].isAlive) {fn(Entity{idx, mSlots[idx].generation});}
+        }
+    }
+
+    //The slot table as is, free list and all, for snapshots (see ECSSnapshot.cpp).
+    //Restoring it exactly keeps the entity handles stored inside of components valid.
+    struct SlotState
+    {
+        U32 generation;
+        U32 nextFree;
+    };
+
+    U32 getSlotCount() const {return mNumSlotsUsed;}
+    U32 getFreeListHead() const {return mFreeListHead;}
+    SlotState getSlotState(U32 idx) const {return {mSlots[idx].generation, mSlots[idx].nextFree};}
+
+    //Throws away every slot and starts over with slotCount slots. Fill them in with restoreSlot(),
+    //then call relinkFreeList(). The free list has to be valid, the snapshot loader checks it.
+    void resetSlots(U32 slotCount, U32 freeListHead, size_t entityCount);
+    void restoreSlot(U32 idx, SlotState const& state, Signature_t const& signature)
+    {
+        mSlots[idx] = {.generation = state.generation, .nextFree = state.nextFree, .signature = signature};
+    }
+
+    //Works out which restored slots are alive and links the free list back up in both directions.
+    void relinkFreeList();
 
 private:
-    inline constexpr static size_t sMaxEntities{1000};
-    std::array<Entity, sMaxEntities> mEntities{};
+    inline constexpr static U32 sEndOfFreeList{~U32{0}};
+
+    //Entity indices are 32 bits and the all ones index marks the end of the free list.
+    inline constexpr static size_t sMaxEntities{sEndOfFreeList};
+    inline constexpr static size_t sDefaultReservation{4096};
+
+    struct Slot
+    {
+        //The generation of the entity in the slot, or the one it gets next while the slot is free.
+        U32 generation{1};
+
+        //Neighbours on the free list while this slot is on it. Doubly linked so
+        //claimEntity() can take any slot off of it without walking it.
+        U32 nextFree{sEndOfFreeList};
+        U32 prevFree{sEndOfFreeList};
+
+        //The generation alone cant tell, since a free slot already has the generation it hands out next.
+        bool isAlive{false};
+
+        Signature_t signature{};
+    };
+
+    void unlinkFree(U32 idx);
+    void pushFree(U32 idx);
+
+    //Chunked so that growing never moves existing slots.
+    ChunkedArray<Slot> mSlots;
+
+    //Head of the intrusive list of removed slots waiting to be recycled.
+    U32 mFreeListHead{sEndOfFreeList};
+
+    //How many slots have ever been handed out (alive or on the free list).
+    U32 mNumSlotsUsed{0};
+
     size_t mCurrentEntityCount{0};
 };
 
-}
\ No newline at end of file
+}
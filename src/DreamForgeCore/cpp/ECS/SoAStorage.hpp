@@ -0,0 +1,266 @@
+#pragma once
+#include "Components.hpp"
+#include "EntityManager.hpp"
+#include "Logging.hpp"
+#include <tuple>
+#include <vector>
+#include <span>
+#include <memory>
+#include <new>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+namespace DF
+{
+
+//Opt in a component type to structure of arrays storage by specializing SoALayout for it.
+//Fields lists the type of every field in the order they are split into streams,
+//split() breaks a component into those fields and join() puts it back together.
+template <typename ComponentT>
+struct SoALayout;
+
+template <>
+struct SoALayout<Transform>
+{
+    enum Field : size_t {POSITION_X, POSITION_Y, SCALE_X, SCALE_Y, ROTATION};
+    using Fields = std::tuple<F32, F32, F32, F32, F64>;
+
+    static Fields split(Transform const& t)
+    {
+        return {t.position.x, t.position.y, t.scale.x, t.scale.y, t.rotation};
+    }
+
+    static Transform join(F32 positionX, F32 positionY, F32 scaleX, F32 scaleY, F64 rotation)
+    {
+        return {{positionX, positionY}, {scaleX, scaleY}, rotation};
+    }
+};
+
+template <>
+struct SoALayout<Velocity>
+{
+    enum Field : size_t {LINEAR_X, LINEAR_Y, ANGULAR};
+    using Fields = std::tuple<F32, F32, F64>;
+
+    static Fields split(Velocity const& v)
+    {
+        return {v.linear.x, v.linear.y, v.angular};
+    }
+
+    static Velocity join(F32 linearX, F32 linearY, F64 angular)
+    {
+        return {{linearX, linearY}, angular};
+    }
+};
+
+//A table of entities that all have every one of ComponentTs, stored as structure of arrays.
+//Every field of every component is its own tightly packed stream aligned for SIMD loads,
+//so a bulk kernel (see TransformKernels.hpp) only streams in the fields it uses. Row i of
+//every stream belongs to getEntities()[i].
+//
+//This is separate from ComponentManager/ArchetypeManager since those hand out ComponentT&
+//everywhere (views, getComponent()) and a component split across streams has no address.
+//Components are read and written by value through get() and set(), or in bulk through getStream().
+template <typename ...ComponentTs>
+class SoAStorage
+{
+    static_assert(sizeof...(ComponentTs) > 0);
+
+public:
+
+    inline constexpr static size_t sStreamAlignment{32};
+
+    SoAStorage()=default;
+    ~SoAStorage()=default;
+
+    SoAStorage(SoAStorage const&)=delete;
+    SoAStorage& operator=(SoAStorage const&)=delete;
+    SoAStorage(SoAStorage&&) noexcept=default;
+    SoAStorage& operator=(SoAStorage&&) noexcept=default;
+
+    void insert(Entity const& entity, ComponentTs const&... components)
+    {
+#ifdef DF_DEBUG
+        if(contains(entity))
+        {
+            Logger::get().stdoutError("attempted to insert an entity into a SoAStorage more than once");
+            return;
+        }
+#endif
+        if(mSize == mCapacity)
+            reserve(std::max<size_t>(mCapacity * 2, 64));
+
+        (writeRow(mSize, components), ...);
+        mEntities.push_back(entity);
+
+        if(entity.getIndex() >= mSparse.size())
+            mSparse.resize(entity.getIndex() + 1, sNullIdx);
+        mSparse[entity.getIndex()] = static_cast<U32>(mSize);
+
+        ++mSize;
+    }
+
+    //Fills the hole with the last row.
+    void erase(Entity const& entity)
+    {
+        auto const idx {denseIdxOf(entity)};
+        if(idx == sNullIdx)
+        {
+#ifdef DF_DEBUG
+            Logger::get().stdoutError("invalid entity supplied to SoAStorage::erase()");
+#endif
+            return;
+        }
+
+        auto const lastIdx {mSize - 1};
+        std::apply([idx, lastIdx](auto&... componentStreams)
+        {
+            (std::apply([idx, lastIdx](auto&... streams){((streams[idx] = streams[lastIdx]), ...);},
+                componentStreams), ...);
+        }, mStreams);
+
+        auto const lastEntity {mEntities[lastIdx]};
+        mEntities[idx] = lastEntity;
+        mSparse[lastEntity.getIndex()] = idx;
+        mSparse[entity.getIndex()] = sNullIdx;
+
+        mEntities.pop_back();
+        --mSize;
+    }
+
+    [[nodiscard]] bool contains(Entity const& entity) const {return denseIdxOf(entity) != sNullIdx;}
+
+    //Gathers the entity's ComponentT back out of its streams. The entity must be in the storage.
+    template <typename ComponentT>
+    [[nodiscard]] ComponentT get(Entity const& entity) const
+    {
+        return readRow<ComponentT>(denseIdxOf(entity));
+    }
+
+    //Scatters value into the entity's ComponentT streams. The entity must be in the storage.
+    template <typename ComponentT>
+    void set(Entity const& entity, ComponentT const& value)
+    {
+        writeRow(denseIdxOf(entity), value);
+    }
+
+    //One field of ComponentT for every row, e.g. getStream<Transform, SoALayout<Transform>::POSITION_X>().
+    template <typename ComponentT, size_t FieldIdx>
+    [[nodiscard]] auto getStream()
+    {
+        auto& stream {std::get<FieldIdx>(std::get<componentIdxOf<ComponentT>()>(mStreams))};
+        return std::span{stream.get(), mSize};
+    }
+
+    std::span<Entity const> getEntities() const {return mEntities;}
+    auto getSize() const {return mSize;}
+    auto getCapacity() const {return mCapacity;}
+
+    //Make room for at least count rows. Rounded up so that every stream
+    //is a whole number of 8 wide SIMD vectors.
+    void reserve(size_t count)
+    {
+        if(count <= mCapacity) {return;}
+        count = (count + 7) & ~size_t{7};
+
+        std::apply([this, count](auto&... componentStreams)
+        {
+            (std::apply([this, count](auto&... streams){(growStream(streams, count), ...);}, componentStreams), ...);
+        }, mStreams);
+
+        mEntities.reserve(count);
+        mCapacity = count;
+    }
+
+private:
+
+    inline constexpr static U32 sNullIdx{~U32{0}};
+
+    struct StreamDeleter
+    {
+        void operator()(void* mem) const
+        {
+            ::operator delete[](mem, std::align_val_t{sStreamAlignment});
+        }
+    };
+
+    template <typename FieldT>
+    using Stream = std::unique_ptr<FieldT[], StreamDeleter>;
+
+    template <typename Fields> struct StreamsOf;
+    template <typename ...FieldTs> struct StreamsOf<std::tuple<FieldTs...>>
+    {
+        static_assert((std::is_trivially_copyable_v<FieldTs> && ...));
+        using type = std::tuple<Stream<FieldTs>...>;
+    };
+
+    template <typename ComponentT>
+    using FieldStreams = typename StreamsOf<typename SoALayout<ComponentT>::Fields>::type;
+
+    template <typename ComponentT>
+    static constexpr size_t componentIdxOf()
+    {
+        static_assert((std::is_same_v<ComponentT, ComponentTs> || ...), "ComponentT is not part of this SoAStorage");
+
+        size_t idx {0};
+        ((std::is_same_v<ComponentT, ComponentTs> ? false : (++idx, true)) && ...);
+        return idx;
+    }
+
+    template <typename FieldT>
+    void growStream(Stream<FieldT>& stream, size_t count)
+    {
+        Stream<FieldT> grown {static_cast<FieldT*>(
+            ::operator new[](count * sizeof(FieldT), std::align_val_t{sStreamAlignment}))};
+
+        if(stream)
+            std::memcpy(grown.get(), stream.get(), mSize * sizeof(FieldT));
+
+        stream = std::move(grown);
+    }
+
+    template <typename ComponentT>
+    void writeRow(size_t row, ComponentT const& value)
+    {
+        auto const fields {SoALayout<ComponentT>::split(value)};
+        auto& streams {std::get<componentIdxOf<ComponentT>()>(mStreams)};
+
+        [&]<size_t ...Fs>(std::index_sequence<Fs...>)
+        {
+            ((std::get<Fs>(streams)[row] = std::get<Fs>(fields)), ...);
+        }(std::make_index_sequence<std::tuple_size_v<decltype(fields)>>{});
+    }
+
+    template <typename ComponentT>
+    ComponentT readRow(size_t row) const
+    {
+        auto const& streams {std::get<componentIdxOf<ComponentT>()>(mStreams)};
+        return std::apply([row](auto const&... fieldStreams)
+        {
+            return SoALayout<ComponentT>::join(fieldStreams[row]...);
+        }, streams);
+    }
+
+    U32 denseIdxOf(Entity const& entity) const
+    {
+        if(entity.getIndex() >= mSparse.size())
+            return sNullIdx;
+
+        //Compare the whole handle to reject stale entities whose index has been recycled.
+        auto const idx {mSparse[entity.getIndex()]};
+        return idx != sNullIdx && mEntities[idx] == entity ? idx : sNullIdx;
+    }
+
+    std::tuple<FieldStreams<ComponentTs>...> mStreams;
+    std::vector<Entity> mEntities;
+
+    //Indexed by entity index.
+    std::vector<U32> mSparse;
+
+    size_t mSize{0};
+    size_t mCapacity{0};
+};
+
+}
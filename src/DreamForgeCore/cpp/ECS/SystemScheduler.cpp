@@ -0,0 +1,93 @@
+#include "SystemScheduler.hpp"
+#include "Logging.hpp"
+
+namespace DF
+{
+
+void SystemScheduler::addSystem(std::string_view name, SystemAccess access, SystemFunc fn)
+{
+    auto system {std::make_unique<System>()};
+    system->name = name;
+    system->access = access;
+    system->fn = std::move(fn);
+    mSystems.push_back(std::move(system));
+    mIsGraphDirty = true;
+}
+
+void SystemScheduler::buildGraph()
+{
+    mRoots.clear();
+
+    for(auto& system : mSystems)
+    {
+        system->dependents.clear();
+        system->dependencyCount = 0;
+    }
+
+    for(U32 later = 0; later < mSystems.size(); ++later)
+    {
+        auto& laterSystem {*mSystems[later]};
+
+        for(U32 earlier = 0; earlier < later; ++earlier)
+        {
+            auto& earlierSystem {*mSystems[earlier]};
+            if(!earlierSystem.access.conflictsWith(laterSystem.access)) {continue;}
+
+            earlierSystem.dependents.push_back(later);
+            ++laterSystem.dependencyCount;
+        }
+
+        if(laterSystem.dependencyCount == 0)
+            mRoots.push_back(later);
+    }
+
+    mIsGraphDirty = false;
+
+    Logger::get().fmtStdoutInfo("system graph built: {} systems, {} can start immediately",
+        mSystems.size(), mRoots.size());
+}
+
+void SystemScheduler::runSystem(U32 systemIdx, F64 deltaTime, TaskGroup& group)
+{
+    auto& system {*mSystems[systemIdx]};
+    system.fn(deltaTime);
+
+    //Whoever finishes a system's last dependency starts it.
+    for(auto const dependentIdx : system.dependents)
+    {
+        if(mSystems[dependentIdx]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            ThreadPool::get().submit([this, dependentIdx, deltaTime, &group]
+            {
+                runSystem(dependentIdx, deltaTime, group);
+            }, &group);
+        }
+    }
+}
+
+void SystemScheduler::run(F64 deltaTime)
+{
+    if(mSystems.empty())
+        return;
+
+    if(mIsGraphDirty)
+        buildGraph();
+
+    for(auto& system : mSystems)
+        system->remaining.store(system->dependencyCount, std::memory_order_relaxed);
+
+    TaskGroup group;
+    auto& pool {ThreadPool::get()};
+
+    for(auto const rootIdx : mRoots)
+    {
+        pool.submit([this, rootIdx, deltaTime, &group]
+        {
+            runSystem(rootIdx, deltaTime, group);
+        }, &group);
+    }
+
+    pool.wait(group);
+}
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include "EntityManager.hpp"
+#include "View.hpp"
+#include "ThreadPool.hpp"
+#include "HelpfulTypeAliases.hpp"
+#include "df_export.hpp"
+
+namespace DF
+{
+
+//Which component types a system reads and which it writes.
+//Exclusive systems conflict with every other system, for things like
+//adding or removing entities that touch storage the access masks dont cover.
+struct SystemAccess
+{
+    Signature_t reads{};
+    Signature_t writes{};
+    bool exclusive{false};
+
+    //Two systems can run at the same time unless one writes something the other touches.
+    bool conflictsWith(SystemAccess const& other) const
+    {
+        return exclusive || other.exclusive ||
+            (writes & (other.reads | other.writes)).any() ||
+            (other.writes & reads).any();
+    }
+};
+
+//Runs the registered systems once per frame. Every system declares the components it
+//reads and writes. A system depends on every system registered before it that it conflicts
+//with, which gives a DAG that keeps the registration order wherever the order matters.
+//Systems whose dependencies have all finished are handed to the ThreadPool, so systems
+//that dont conflict run concurrently.
+class DF_DLL_API SystemScheduler
+{
+public:
+
+    using SystemFunc = std::function<void(F64 deltaTime)>;
+
+    SystemScheduler()=default;
+    ~SystemScheduler()=default;
+
+    SystemScheduler(SystemScheduler const&)=delete;
+    SystemScheduler(SystemScheduler&&)=delete;
+    SystemScheduler& operator=(SystemScheduler const&)=delete;
+    SystemScheduler& operator=(SystemScheduler&&)=delete;
+
+    void addSystem(std::string_view name, SystemAccess access, SystemFunc fn);
+
+    //addSystem<TypeList<Transform>, TypeList<Velocity>>("drag", fn) reads
+    //Transform and writes Velocity. Components that are written dont need to also be read.
+    template <typename ReadList, typename WriteList = TypeList<>>
+    void addSystem(std::string_view name, SystemFunc fn)
+    {
+        addSystem(name, SystemAccess{signatureOf(ReadList{}), signatureOf(WriteList{})}, std::move(fn));
+    }
+
+    //Runs every system once and returns when they have all finished.
+    void run(F64 deltaTime);
+
+    auto getSystemCount() const {return mSystems.size();}
+
+private:
+
+    template <typename ...ComponentTs>
+    static Signature_t signatureOf(TypeList<ComponentTs...>) {return makeSignature<ComponentTs...>();}
+
+    struct System
+    {
+        std::string name;
+        SystemAccess access;
+        SystemFunc fn;
+
+        //Indices of the systems that wait on this one.
+        std::vector<U32> dependents;
+        U32 dependencyCount{0};
+
+        //Dependencies left to finish this frame.
+        std::atomic<U32> remaining{0};
+    };
+
+    void buildGraph();
+    void runSystem(U32 systemIdx, F64 deltaTime, TaskGroup& group);
+
+    std::vector<std::unique_ptr<System>> mSystems;
+
+    //Systems with no dependencies. They start every frame.
+    std::vector<U32> mRoots;
+
+    bool mIsGraphDirty{false};
+};
+
+}
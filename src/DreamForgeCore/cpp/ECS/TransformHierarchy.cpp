@@ -0,0 +1,285 @@
+#include "TransformHierarchy.hpp"
+#include "ECS.hpp"
+#include "ThreadPool.hpp"
+#include "Logging.hpp"
+#include <cmath>
+#include <utility>
+#include <algorithm>
+
+namespace DF
+{
+
+//translate * rotate * scale in the xy plane.
+static glm::mat4 makeLocalMatrix(Transform const& transform)
+{
+    auto const cos {static_cast<F32>(std::cos(transform.rotation))};
+    auto const sin {static_cast<F32>(std::sin(transform.rotation))};
+
+    glm::mat4 local {1.0f};
+    local[0] = glm::vec4{cos * transform.scale.x, sin * transform.scale.x, 0.0f, 0.0f};
+    local[1] = glm::vec4{-sin * transform.scale.y, cos * transform.scale.y, 0.0f, 0.0f};
+    local[3] = glm::vec4{transform.position.x, transform.position.y, 0.0f, 1.0f};
+    return local;
+}
+
+//parent * local, skipping the parts of the product that are always 0 or 1 for 2D transforms.
+static glm::mat4 combine(glm::mat4 const& parent, glm::mat4 const& local)
+{
+    glm::mat4 world {1.0f};
+    world[0] = parent[0] * local[0].x + parent[1] * local[0].y;
+    world[1] = parent[0] * local[1].x + parent[1] * local[1].y;
+    world[3] = parent[0] * local[3].x + parent[1] * local[3].y + parent[3];
+    return world;
+}
+
+glm::mat4 const* TransformHierarchy::getWorldMatrix(Entity const& entity) const
+{
+    if(entity.getIndex() >= mNodeOf.size())
+        return nullptr;
+
+    auto const node {mNodeOf[entity.getIndex()]};
+    if(node == sNoParent || mEntities[node] != entity)
+        return nullptr;
+
+    return &mWorldMatrices[node];
+}
+
+bool TransformHierarchy::needsRebuild(U32 sinceTick) const
+{
+    auto& ecs {ECS::get()};
+
+    bool lostNode {false};
+    auto const checkRemoved {[this, &lostNode](Entity const& entity)
+    {
+        lostNode = lostNode || (entity.getIndex() < mNodeOf.size() && mNodeOf[entity.getIndex()] != sNoParent);
+    }};
+    //A log that was trimmed past sinceTick may have lost a node without saying so, so rebuild to be safe.
+    auto const sawRemovals {ecs.eachRemovedSince<Transform>(sinceTick, checkRemoved) &&
+        ecs.eachRemovedSince<Hierarchy>(sinceTick, checkRemoved)};
+
+    if(lostNode || !sawRemovals)
+        return true;
+
+    //Adding a Hierarchy also stamps it as changed, so this covers new nodes and reparenting.
+    auto const reparented {ecs.view<Transform, Hierarchy>().changedSince<Hierarchy>(sinceTick)};
+    auto const added {ecs.view<Transform, Hierarchy>().addedSince<Transform>(sinceTick)};
+    return reparented.begin() != reparented.end() || added.begin() != added.end();
+}
+
+void TransformHierarchy::rebuild()
+{
+    struct Node
+    {
+        Entity entity;
+        Entity parent;
+    };
+
+    std::vector<Node> nodes;
+    U32 maxEntityIdx {0};
+    ECS::get().view<Transform, Hierarchy>().each([&](Entity entity, Transform&, Hierarchy& hierarchy)
+    {
+        nodes.push_back({entity, hierarchy.parent});
+        maxEntityIdx = std::max(maxEntityIdx, entity.getIndex());
+    });
+
+    auto const nodeCount {static_cast<U32>(nodes.size())};
+
+    //Index into nodes of each node's parent. Parents that are dead or not
+    //part of the hierarchy themselves make the node a root.
+    mNodeOf.assign(nodes.empty() ? 0 : maxEntityIdx + 1, sNoParent);
+    for(U32 i = 0; i < nodeCount; ++i)
+        mNodeOf[nodes[i].entity.getIndex()] = i;
+
+    auto& ecs {ECS::get()};
+    std::vector<U32> parentOf(nodeCount, sNoParent);
+    std::vector<U32> childStarts(nodeCount + 1, 0);
+    U32 orphanCount {0};
+    for(U32 i = 0; i < nodeCount; ++i)
+    {
+        auto const& parent {nodes[i].parent};
+        if(parent.isNull()) {continue;}
+
+        auto const parentNode {parent.getIndex() < mNodeOf.size() ? mNodeOf[parent.getIndex()] : sNoParent};
+        if(parentNode == sNoParent || nodes[parentNode].entity != parent)
+        {
+            //A dead parent just means the child outlived it, but a living one was left out by mistake.
+            if(ecs.isAlive(parent)) {++orphanCount;}
+            continue;
+        }
+
+        parentOf[i] = parentNode;
+        ++childStarts[parentNode + 1];
+    }
+
+    if(orphanCount != 0)
+    {
+        Logger::get().fmtStdoutError("{} entities have a parent without a Transform and a Hierarchy and are "
+            "treated as roots of the transform hierarchy", orphanCount);
+    }
+
+    //Children grouped by parent, childStarts[p] to childStarts[p + 1].
+    for(U32 i = 0; i < nodeCount; ++i)
+        childStarts[i + 1] += childStarts[i];
+
+    std::vector<U32> children(nodeCount);
+    std::vector<U32> fill {childStarts.begin(), childStarts.end() - 1};
+    for(U32 i = 0; i < nodeCount; ++i)
+    {
+        if(parentOf[i] != sNoParent) {children[fill[parentOf[i]]++] = i;}
+    }
+
+    mEntities.clear();
+    mParents.clear();
+    std::vector<U32> newIdxOf(nodeCount, sNoParent);
+    std::vector<U32> stack;
+
+    for(U32 root = 0; root < nodeCount; ++root)
+    {
+        if(parentOf[root] != sNoParent) {continue;}
+
+        stack.push_back(root);
+        while(!stack.empty())
+        {
+            auto const node {stack.back()};
+            stack.pop_back();
+
+            newIdxOf[node] = static_cast<U32>(mEntities.size());
+            mEntities.push_back(nodes[node].entity);
+            mParents.push_back(parentOf[node] == sNoParent ? sNoParent : newIdxOf[parentOf[node]]);
+
+            //Pushed in reverse so that the children come out in order.
+            for(auto child {childStarts[node + 1]}; child-- > childStarts[node];)
+                stack.push_back(children[child]);
+        }
+    }
+
+    if(mEntities.size() != nodeCount)
+    {
+        Logger::get().fmtStdoutError("{} entities are parented in a cycle and are left out of the "
+            "transform hierarchy", nodeCount - mEntities.size());
+    }
+
+    for(auto& nodeIdx : mNodeOf)
+    {
+        if(nodeIdx != sNoParent) {nodeIdx = newIdxOf[nodeIdx];}
+    }
+
+    //Every subtree is contiguous, so each one ends where the last of its descendants does.
+    auto const size {mEntities.size()};
+    mSubtreeEnds.resize(size);
+    for(size_t i = 0; i < size; ++i)
+        mSubtreeEnds[i] = static_cast<U32>(i + 1);
+
+    for(size_t i = size; i-- > 0;)
+    {
+        if(mParents[i] != sNoParent)
+            mSubtreeEnds[mParents[i]] = std::max(mSubtreeEnds[mParents[i]], mSubtreeEnds[i]);
+    }
+
+    mWorldMatrices.resize(size);
+
+    //Every root's subtree is new.
+    mDirtyNodes.clear();
+    for(size_t i = 0; i < size; ++i)
+    {
+        if(mParents[i] == sNoParent) {mDirtyNodes.push_back(static_cast<U32>(i));}
+    }
+}
+
+void TransformHierarchy::markChangedTransforms(U32 sinceTick)
+{
+    ECS::get().view<Transform, Hierarchy>().changedSince<Transform>(sinceTick).each(
+        [this](Entity entity, Transform&, Hierarchy&)
+        {
+            //entities in a parent cycle were left out of the last rebuild
+            if(entity.getIndex() >= mNodeOf.size())
+                return;
+
+            auto const node {mNodeOf[entity.getIndex()]};
+            if(node != sNoParent)
+                mDirtyNodes.push_back(node);
+        });
+}
+
+void TransformHierarchy::propagate(size_t begin, size_t end)
+{
+    auto& ecs {ECS::get()};
+
+    for(size_t i = begin; i < end; ++i)
+    {
+        auto const local {makeLocalMatrix(*ecs.getComponent<Transform>(mEntities[i]))};
+        mWorldMatrices[i] = mParents[i] == sNoParent ? local : combine(mWorldMatrices[mParents[i]], local);
+    }
+}
+
+void TransformHierarchy::update()
+{
+    auto const sinceTick {std::exchange(mLastUpdateTick, ECS::get().advanceChangeTick())};
+
+    if(needsRebuild(sinceTick))
+        rebuild();
+    else
+        markChangedTransforms(sinceTick);
+
+    //A dirty node's whole subtree gets recomputed, so the dirty nodes inside of it can be dropped.
+    //Sorted, a node is inside of an earlier subtree exactly when it comes before that subtree's end.
+    std::ranges::sort(mDirtyNodes);
+    mRanges.clear();
+    size_t coveredEnd {0};
+    for(auto const node : mDirtyNodes)
+    {
+        if(node < coveredEnd) {continue;}
+        coveredEnd = mSubtreeEnds[node];
+        mRanges.push_back({node, coveredEnd});
+    }
+    mDirtyNodes.clear();
+
+    //Split the big subtrees by computing their root now,
+    //and queueing each of the root's child subtrees instead.
+    size_t work {0};
+    for(size_t r = 0; r < mRanges.size(); ++r)
+    {
+        auto const range {mRanges[r]};
+        if(range.end - range.begin <= sParallelGrain)
+        {
+            work += range.end - range.begin;
+            continue;
+        }
+
+        propagate(range.begin, range.begin + 1);
+        mRanges[r] = {range.begin, range.begin};
+
+        for(auto child {range.begin + 1}; child < range.end; child = mSubtreeEnds[child])
+            mRanges.push_back({child, mSubtreeEnds[child]});
+    }
+
+    auto& pool {ThreadPool::get()};
+    if(work <= sParallelGrain || pool.getWorkerCount() == 0)
+    {
+        for(auto const& range : mRanges)
+            propagate(range.begin, range.end);
+        return;
+    }
+
+    //Group the ranges into batches of about sParallelGrain nodes. These index into mRanges.
+    mBatches.clear();
+    size_t batchWork {sParallelGrain};
+    for(size_t r = 0; r < mRanges.size(); ++r)
+    {
+        if(batchWork >= sParallelGrain)
+        {
+            mBatches.push_back({r, r});
+            batchWork = 0;
+        }
+        mBatches.back().end = r + 1;
+        batchWork += mRanges[r].end - mRanges[r].begin;
+    }
+
+    pool.parallelFor(mBatches.size(), [this](size_t batchIdx)
+    {
+        for(auto r {mBatches[batchIdx].begin}; r < mBatches[batchIdx].end; ++r)
+            propagate(mRanges[r].begin, mRanges[r].end);
+    });
+}
+
+}
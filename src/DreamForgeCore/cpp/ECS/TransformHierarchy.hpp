@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+#include <span>
+#include "glm/glm.hpp"
+#include "Entity.hpp"
+#include "HelpfulTypeAliases.hpp"
+#include "df_export.hpp"
+
+namespace DF
+{
+
+//Computes world matrices for every entity with a Transform and a Hierarchy.
+//
+//The nodes are kept in depth first order, so a parent always comes before its children
+//and every subtree is one contiguous range of the arrays. Propagating is then a single
+//linear pass where each node reads the world matrix of a parent that was already computed.
+//
+//Only the subtrees under Transforms that changed since the last update are recomputed
+//(see ECS::markChanged()). The changed Transforms come from a filtered view, which skips the
+//blocks of the Transform pool that nothing was written to, and go into a list of dirty nodes,
+//so a frame where little moved doesnt walk every node. Big dirty subtrees are split into their
+//child subtrees, which are independent of each other, and those are spread over the ThreadPool.
+//
+//The order is rebuilt from scratch whenever a Hierarchy or Transform is added or removed
+//or a Hierarchy is marked as changed, which should be rare compared to moving things around.
+//An entity whose parent is dead or isnt part of the hierarchy (it needs both a Transform
+//and a Hierarchy, with a null parent for roots) is treated as a root, and rebuilding reports
+//the ones whose parent is alive so that a forgotten Hierarchy doesnt go unnoticed.
+class DF_DLL_API TransformHierarchy
+{
+public:
+
+    TransformHierarchy()=default;
+    ~TransformHierarchy()=default;
+
+    TransformHierarchy(TransformHierarchy const&)=delete;
+    TransformHierarchy(TransformHierarchy&&)=delete;
+    TransformHierarchy& operator=(TransformHierarchy const&)=delete;
+    TransformHierarchy& operator=(TransformHierarchy&&)=delete;
+
+    //Brings the world matrices up to date with the Transforms. Has to run after the frame's
+    //commands were flushed, since it only sees components that are actually in the ECS.
+    void update();
+
+    //Returns nullptr if the entity isnt part of the hierarchy.
+    [[nodiscard]] glm::mat4 const* getWorldMatrix(Entity const& entity) const;
+
+    //Every node in parent before child order, lined up with getWorldMatrices().
+    std::span<Entity const> getEntities() const {return mEntities;}
+    std::span<glm::mat4 const> getWorldMatrices() const {return mWorldMatrices;}
+
+private:
+
+    inline constexpr static U32 sNoParent{~U32{0}};
+
+    //Dirty subtrees bigger than this are split up to run in parallel.
+    inline constexpr static size_t sParallelGrain{1024};
+
+    bool needsRebuild(U32 sinceTick) const;
+    void rebuild();
+    void markChangedTransforms(U32 sinceTick);
+
+    //Recompute every node in [begin, end), which has to be whole subtrees.
+    void propagate(size_t begin, size_t end);
+
+    //Node arrays, all in depth first order.
+    std::vector<Entity> mEntities;
+    std::vector<U32> mParents;
+    std::vector<U32> mSubtreeEnds;
+    std::vector<glm::mat4> mWorldMatrices;
+
+    //Nodes whose subtree has to be recomputed, in no particular order and possibly repeated.
+    std::vector<U32> mDirtyNodes;
+
+    //Entity index to node index.
+    std::vector<U32> mNodeOf;
+
+    //Scratch for update(), kept around so it doesnt allocate every frame.
+    struct Range
+    {
+        size_t begin;
+        size_t end;
+    };
+    std::vector<Range> mRanges;
+    std::vector<Range> mBatches;
+
+    U32 mLastUpdateTick{0};
+};
+
+}
@@ -0,0 +1,220 @@
+#include "TransformKernels.hpp"
+#include <cmath>
+#include <numbers>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define DF_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define DF_SIMD_SSE2
+#endif
+
+namespace DF
+{
+
+static constexpr F64 sTwoPi {2.0 * std::numbers::pi};
+static constexpr F32 sPi {std::numbers::pi_v<F32>};
+static constexpr F32 sHalfPi {std::numbers::pi_v<F32> / 2.0f};
+
+//Taylor series coefficients of sin(x) up to x^11. Good to about 6e-8 over [-pi/2, pi/2].
+static constexpr F32 sSin3 {-1.0f / 6.0f};
+static constexpr F32 sSin5 {1.0f / 120.0f};
+static constexpr F32 sSin7 {-1.0f / 5040.0f};
+static constexpr F32 sSin9 {1.0f / 362880.0f};
+static constexpr F32 sSin11 {-1.0f / 39916800.0f};
+
+static F64 wrapAngle(F64 radians)
+{
+    return radians - sTwoPi * std::nearbyint(radians / sTwoPi);
+}
+
+#if defined(DF_SIMD_AVX2)
+
+//sin(x) for x in [-pi, pi]. Folded into [-pi/2, pi/2] with sin(x) = sin(pi - x) first.
+static __m256 sin8(__m256 x)
+{
+    auto const pi {_mm256_set1_ps(sPi)};
+    auto const halfPi {_mm256_set1_ps(sHalfPi)};
+
+    x = _mm256_blendv_ps(x, _mm256_sub_ps(pi, x), _mm256_cmp_ps(x, halfPi, _CMP_GT_OQ));
+    x = _mm256_blendv_ps(x, _mm256_sub_ps(_mm256_sub_ps(_mm256_setzero_ps(), pi), x),
+        _mm256_cmp_ps(x, _mm256_sub_ps(_mm256_setzero_ps(), halfPi), _CMP_LT_OQ));
+
+    auto const x2 {_mm256_mul_ps(x, x)};
+    auto p {_mm256_set1_ps(sSin11)};
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(sSin9));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(sSin7));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(sSin5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(sSin3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(1.0f));
+    return _mm256_mul_ps(p, x);
+}
+
+//Wrap 4 angles into [-pi, pi] in double precision before narrowing them.
+static __m128 wrapAngles4(F64 const* radians)
+{
+    auto const r {_mm256_loadu_pd(radians)};
+    auto const turns {_mm256_round_pd(_mm256_mul_pd(r, _mm256_set1_pd(1.0 / sTwoPi)),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)};
+    return _mm256_cvtpd_ps(_mm256_sub_pd(r, _mm256_mul_pd(turns, _mm256_set1_pd(sTwoPi))));
+}
+
+#elif defined(DF_SIMD_SSE2)
+
+static __m128 select4(__m128 mask, __m128 ifTrue, __m128 ifFalse)
+{
+    return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+}
+
+//sin(x) for x in [-pi, pi]. Folded into [-pi/2, pi/2] with sin(x) = sin(pi - x) first.
+static __m128 sin4(__m128 x)
+{
+    auto const pi {_mm_set1_ps(sPi)};
+    auto const halfPi {_mm_set1_ps(sHalfPi)};
+
+    x = select4(_mm_cmpgt_ps(x, halfPi), _mm_sub_ps(pi, x), x);
+    x = select4(_mm_cmplt_ps(x, _mm_sub_ps(_mm_setzero_ps(), halfPi)),
+        _mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), pi), x), x);
+
+    auto const x2 {_mm_mul_ps(x, x)};
+    auto p {_mm_set1_ps(sSin11)};
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(sSin9));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(sSin7));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(sSin5));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(sSin3));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.0f));
+    return _mm_mul_ps(p, x);
+}
+
+//Wrap 2 angles into [-pi, pi] in double precision before narrowing them.
+//SSE2 has no round instruction, and converting to a 32 bit int saturates for big angles.
+//Instead add and subtract 1.5 * 2^52, which leaves no bits below the point so the add
+//rounds to nearest even like std::nearbyint(). Past 2^51 turns every double is a whole
+//number already and is kept as is.
+static __m128 wrapAngles2(F64 const* radians)
+{
+    auto const r {_mm_loadu_pd(radians)};
+    auto const t {_mm_mul_pd(r, _mm_set1_pd(1.0 / sTwoPi))};
+
+    auto const magic {_mm_set1_pd(0x1.8p52)};
+    auto const rounded {_mm_sub_pd(_mm_add_pd(t, magic), magic)};
+    auto const isWhole {_mm_cmpge_pd(_mm_andnot_pd(_mm_set1_pd(-0.0), t), _mm_set1_pd(0x1p51))};
+    auto const turns {_mm_or_pd(_mm_and_pd(isWhole, t), _mm_andnot_pd(isWhole, rounded))};
+
+    return _mm_cvtpd_ps(_mm_sub_pd(r, _mm_mul_pd(turns, _mm_set1_pd(sTwoPi))));
+}
+
+#endif
+
+void integrateTransforms(std::span<F32> positionX, std::span<F32> positionY, std::span<F64> rotation,
+    std::span<F32 const> linearX, std::span<F32 const> linearY, std::span<F64 const> angular, F32 deltaTime)
+{
+    auto const count {positionX.size()};
+    size_t i {0};
+
+#if defined(DF_SIMD_AVX2)
+    auto const dt {_mm256_set1_ps(deltaTime)};
+    auto const dtd {_mm256_set1_pd(deltaTime)};
+
+    for(; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_ps(&positionX[i], _mm256_add_ps(_mm256_loadu_ps(&positionX[i]),
+            _mm256_mul_ps(_mm256_loadu_ps(&linearX[i]), dt)));
+        _mm256_storeu_ps(&positionY[i], _mm256_add_ps(_mm256_loadu_ps(&positionY[i]),
+            _mm256_mul_ps(_mm256_loadu_ps(&linearY[i]), dt)));
+
+        _mm256_storeu_pd(&rotation[i], _mm256_add_pd(_mm256_loadu_pd(&rotation[i]),
+            _mm256_mul_pd(_mm256_loadu_pd(&angular[i]), dtd)));
+        _mm256_storeu_pd(&rotation[i + 4], _mm256_add_pd(_mm256_loadu_pd(&rotation[i + 4]),
+            _mm256_mul_pd(_mm256_loadu_pd(&angular[i + 4]), dtd)));
+    }
+#elif defined(DF_SIMD_SSE2)
+    auto const dt {_mm_set1_ps(deltaTime)};
+    auto const dtd {_mm_set1_pd(deltaTime)};
+
+    for(; i + 4 <= count; i += 4)
+    {
+        _mm_storeu_ps(&positionX[i], _mm_add_ps(_mm_loadu_ps(&positionX[i]),
+            _mm_mul_ps(_mm_loadu_ps(&linearX[i]), dt)));
+        _mm_storeu_ps(&positionY[i], _mm_add_ps(_mm_loadu_ps(&positionY[i]),
+            _mm_mul_ps(_mm_loadu_ps(&linearY[i]), dt)));
+
+        _mm_storeu_pd(&rotation[i], _mm_add_pd(_mm_loadu_pd(&rotation[i]),
+            _mm_mul_pd(_mm_loadu_pd(&angular[i]), dtd)));
+        _mm_storeu_pd(&rotation[i + 2], _mm_add_pd(_mm_loadu_pd(&rotation[i + 2]),
+            _mm_mul_pd(_mm_loadu_pd(&angular[i + 2]), dtd)));
+    }
+#endif
+
+    //Whatever didnt fill a whole vector.
+    for(; i < count; ++i)
+    {
+        positionX[i] += linearX[i] * deltaTime;
+        positionY[i] += linearY[i] * deltaTime;
+        rotation[i] += angular[i] * static_cast<F64>(deltaTime);
+    }
+}
+
+void makeTransformMatrices(std::span<F32 const> positionX, std::span<F32 const> positionY,
+    std::span<F32 const> scaleX, std::span<F32 const> scaleY, std::span<F64 const> rotation,
+    TransformMatrixStreams const& out)
+{
+    auto const count {positionX.size()};
+    size_t i {0};
+
+#if defined(DF_SIMD_AVX2)
+    for(; i + 8 <= count; i += 8)
+    {
+        auto const angle {_mm256_insertf128_ps(_mm256_castps128_ps256(wrapAngles4(&rotation[i])),
+            wrapAngles4(&rotation[i + 4]), 1)};
+
+        //cos(x) = sin(x + pi/2), which is back in range after the fold in sin8().
+        auto const sin {sin8(angle)};
+        auto const cos {sin8(_mm256_add_ps(angle, _mm256_set1_ps(sHalfPi)))};
+        auto const sx {_mm256_loadu_ps(&scaleX[i])};
+        auto const sy {_mm256_loadu_ps(&scaleY[i])};
+
+        _mm256_storeu_ps(&out.c0x[i], _mm256_mul_ps(cos, sx));
+        _mm256_storeu_ps(&out.c0y[i], _mm256_mul_ps(sin, sx));
+        _mm256_storeu_ps(&out.c1x[i], _mm256_mul_ps(_mm256_sub_ps(_mm256_setzero_ps(), sin), sy));
+        _mm256_storeu_ps(&out.c1y[i], _mm256_mul_ps(cos, sy));
+        _mm256_storeu_ps(&out.c2x[i], _mm256_loadu_ps(&positionX[i]));
+        _mm256_storeu_ps(&out.c2y[i], _mm256_loadu_ps(&positionY[i]));
+    }
+#elif defined(DF_SIMD_SSE2)
+    for(; i + 4 <= count; i += 4)
+    {
+        auto const angle {_mm_movelh_ps(wrapAngles2(&rotation[i]), wrapAngles2(&rotation[i + 2]))};
+
+        //cos(x) = sin(x + pi/2), which is back in range after the fold in sin4().
+        auto const sin {sin4(angle)};
+        auto const cos {sin4(_mm_add_ps(angle, _mm_set1_ps(sHalfPi)))};
+        auto const sx {_mm_loadu_ps(&scaleX[i])};
+        auto const sy {_mm_loadu_ps(&scaleY[i])};
+
+        _mm_storeu_ps(&out.c0x[i], _mm_mul_ps(cos, sx));
+        _mm_storeu_ps(&out.c0y[i], _mm_mul_ps(sin, sx));
+        _mm_storeu_ps(&out.c1x[i], _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), sin), sy));
+        _mm_storeu_ps(&out.c1y[i], _mm_mul_ps(cos, sy));
+        _mm_storeu_ps(&out.c2x[i], _mm_loadu_ps(&positionX[i]));
+        _mm_storeu_ps(&out.c2y[i], _mm_loadu_ps(&positionY[i]));
+    }
+#endif
+
+    for(; i < count; ++i)
+    {
+        auto const angle {wrapAngle(rotation[i])};
+        auto const sin {static_cast<F32>(std::sin(angle))};
+        auto const cos {static_cast<F32>(std::cos(angle))};
+
+        out.c0x[i] = cos * scaleX[i];
+        out.c0y[i] = sin * scaleX[i];
+        out.c1x[i] = -sin * scaleY[i];
+        out.c1y[i] = cos * scaleY[i];
+        out.c2x[i] = positionX[i];
+        out.c2y[i] = positionY[i];
+    }
+}
+
+}
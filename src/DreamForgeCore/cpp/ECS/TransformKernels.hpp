@@ -0,0 +1,60 @@
+#pragma once
+#include "SoAStorage.hpp"
+#include <span>
+
+namespace DF
+{
+
+//Bulk Transform math over SoA streams (see SoAStorage.hpp). They use AVX2 when the core
+//is compiled with it (DF_ENABLE_AVX2 in CMake), SSE2 otherwise on x86, and plain loops
+//everywhere else. Every span passed to one call has to be the same size.
+
+//position += linear * dt, rotation += angular * dt
+void integrateTransforms(std::span<F32> positionX, std::span<F32> positionY, std::span<F64> rotation,
+    std::span<F32 const> linearX, std::span<F32 const> linearY, std::span<F64 const> angular, F32 deltaTime);
+
+//The columns of the 2D affine matrix translate * rotate * scale, one stream per element.
+struct TransformMatrixStreams
+{
+    std::span<F32> c0x, c0y;
+    std::span<F32> c1x, c1y;
+    std::span<F32> c2x, c2y;
+};
+
+//Sines and cosines are computed in single precision after the
+//rotation is wrapped into [-pi, pi] in double precision.
+void makeTransformMatrices(std::span<F32 const> positionX, std::span<F32 const> positionY,
+    std::span<F32 const> scaleX, std::span<F32 const> scaleY, std::span<F64 const> rotation,
+    TransformMatrixStreams const& out);
+
+inline void integrateTransforms(SoAStorage<Transform, Velocity>& storage, F32 deltaTime)
+{
+    using TransformField = SoALayout<Transform>;
+    using VelocityField = SoALayout<Velocity>;
+
+    integrateTransforms(
+        storage.getStream<Transform, TransformField::POSITION_X>(),
+        storage.getStream<Transform, TransformField::POSITION_Y>(),
+        storage.getStream<Transform, TransformField::ROTATION>(),
+        storage.getStream<Velocity, VelocityField::LINEAR_X>(),
+        storage.getStream<Velocity, VelocityField::LINEAR_Y>(),
+        storage.getStream<Velocity, VelocityField::ANGULAR>(),
+        deltaTime);
+}
+
+//out must have room for a matrix per row of storage.
+template <typename ...ComponentTs>
+void makeTransformMatrices(SoAStorage<ComponentTs...>& storage, TransformMatrixStreams const& out)
+{
+    using TransformField = SoALayout<Transform>;
+
+    makeTransformMatrices(
+        storage.template getStream<Transform, TransformField::POSITION_X>(),
+        storage.template getStream<Transform, TransformField::POSITION_Y>(),
+        storage.template getStream<Transform, TransformField::SCALE_X>(),
+        storage.template getStream<Transform, TransformField::SCALE_Y>(),
+        storage.template getStream<Transform, TransformField::ROTATION>(),
+        out);
+}
+
+}
@@ -0,0 +1,503 @@
+#pragma once
+#include "EntityManager.hpp"
+#include "ComponentManager.hpp"
+#include "ArchetypeManager.hpp"
+#include "ThreadPool.hpp"
+#include "ChangeTracking.hpp"
+#include <tuple>
+#include <array>
+#include <utility>
+#include <iterator>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+namespace DF
+{
+
+template <typename ...Ts> struct TypeList {};
+
+//How View::parallelEach() splits up the work.
+enum struct ParallelMode : U8
+{
+    //Ranges are at least grainSize entities, and bigger when there are a lot of entities
+    //per thread, so the split depends on the machine's core count.
+    FAST,
+
+    //Ranges are exactly grainSize entities (or whole archetype chunks), so the same world
+    //is always split the same way on every machine. Per range results combined in range
+    //order are then reproducible, e.g. for lockstep or replayable simulation.
+    DETERMINISTIC
+};
+
+template <typename ...ComponentTs>
+Signature_t makeSignature()
+{
+    Signature_t signature;
+    (signature.set(GetIDFromType<ComponentTs>()), ...);
+    return signature;
+}
+
+//A query over every entity that has all of IncludeTs and none of ExcludeTs.
+//Get one with ECS::view<IncludeTs...>() and narrow it with .without<ExcludeTs...>().
+//Either call each(fn) with fn(Entity, IncludeTs&...), or range-for over it
+//with for(auto [entity, a, b] : view).
+//
+//With sparse set storage the view walks the smallest of the included component arrays
+//and filters it with the entity signatures, so the cost is proportional to the rarest
+//component. With archetype storage it walks the chunks of the matching archetypes.
+//
+//addedSince<Ts...>(tick) and changedSince<Ts...>(tick) narrow the view down to the
+//entities whose Ts were added or changed after tick, for reactive systems that only
+//need to look at what changed since they last ran (see ECS::advanceChangeTick()).
+//A filtered view leads with one of the filtered pools and skips its tick blocks (or the
+//archetype chunks) that have nothing newer than tick, so a few changes scattered over a big
+//pool only cost the blocks they landed in.
+//
+//Adding or removing components or entities while iterating invalidates the view.
+template <typename IncludeList, typename ExcludeList = TypeList<>>
+class View;
+
+template <typename ...IncludeTs, typename ...ExcludeTs>
+class View<TypeList<IncludeTs...>, TypeList<ExcludeTs...>>
+{
+    static_assert(sizeof...(IncludeTs) > 0, "a view needs at least one component type to include");
+
+public:
+
+    View(EntityManager const& entityManager, ComponentManager& componentManager,
+        ArchetypeManager& archetypeManager, bool useArchetypes, TickFilter const& filter = {})
+        : mEntityManager{entityManager}, mComponentManager{componentManager},
+          mArchetypeManager{archetypeManager}, mUseArchetypes{useArchetypes},
+          mPools{&componentManager.getArray<IncludeTs>()...}, mFilter{filter}
+    {
+        pickLead();
+    }
+
+    //The same view, but also skipping entities that have any of ComponentTs.
+    template <typename ...ComponentTs>
+    [[nodiscard]] View<TypeList<IncludeTs...>, TypeList<ExcludeTs..., ComponentTs...>> without() const
+    {
+        return {mEntityManager, mComponentManager, mArchetypeManager, mUseArchetypes, mFilter};
+    }
+
+    //The same view, but only with the entities whose ComponentTs were added after tick.
+    template <typename ...ComponentTs>
+    [[nodiscard]] View addedSince(U32 tick) const
+    {
+        static_assert(sizeof...(ComponentTs) > 0);
+        static_assert((isIncluded<ComponentTs>() && ...), "can only filter on components the view includes");
+
+        auto copy {*this};
+        copy.mFilter.added |= makeSignature<ComponentTs...>();
+        copy.mFilter.sinceTick = tick;
+        copy.pickLead();
+        return copy;
+    }
+
+    //The same view, but only with the entities whose ComponentTs were added
+    //or marked as changed (ECS::markChanged()) after tick.
+    template <typename ...ComponentTs>
+    [[nodiscard]] View changedSince(U32 tick) const
+    {
+        static_assert(sizeof...(ComponentTs) > 0);
+        static_assert((isIncluded<ComponentTs>() && ...), "can only filter on components the view includes");
+
+        auto copy {*this};
+        copy.mFilter.changed |= makeSignature<ComponentTs...>();
+        copy.mFilter.sinceTick = tick;
+        copy.pickLead();
+        return copy;
+    }
+
+    //Calls fn(Entity, IncludeTs&...) for every entity in the view.
+    template <typename Func>
+    void each(Func&& fn)
+    {
+        if(mUseArchetypes)
+        {
+            mArchetypeManager.each<IncludeTs...>(fn, mExcluded, mFilter);
+            return;
+        }
+
+        eachWithLead(fn, std::index_sequence_for<IncludeTs...>{});
+    }
+
+    //Like each(), but the entities are split into ranges that run on the ThreadPool.
+    //fn is called as fn(Entity, IncludeTs&...) or, if it accepts it, fn(rangeIdx, Entity, IncludeTs&...)
+    //so it can accumulate into per range slots. fn must only write to the components it is given.
+    //Returns the number of ranges.
+    template <typename Func>
+    size_t parallelEach(Func&& fn, size_t grainSize = 1024, ParallelMode mode = ParallelMode::FAST)
+    {
+        grainSize = std::max<size_t>(grainSize, 1);
+
+        if(mUseArchetypes)
+            return parallelEachArchetypes(fn, grainSize, mode);
+
+        return parallelEachWithLead(fn, grainSize, mode, std::index_sequence_for<IncludeTs...>{});
+    }
+
+    //How many entities the sparse set walk will visit at most.
+    size_t getSizeHint() const
+    {
+        std::array<size_t, sizeof...(IncludeTs)> const sizes {std::get<ComponentArray<IncludeTs>*>(mPools)->getSize()...};
+        return sizes[mLeadIdx];
+    }
+
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = std::tuple<Entity, IncludeTs&...>;
+        using reference = value_type;
+
+        Iterator()=default;
+
+        reference operator*() const
+        {
+            if(mView->mUseArchetypes)
+            {
+                return {mView->mArchetypeManager.getEntity(mCursor),
+                    mView->mArchetypeManager.template getComponent<IncludeTs>(mCursor)...};
+            }
+
+            auto const entity {(*mLeadEntities)[mIdx]};
+            return {entity, std::get<ComponentArray<IncludeTs>*>(mView->mPools)->getComponentUnchecked(entity)...};
+        }
+
+        Iterator& operator++()
+        {
+            if(mView->mUseArchetypes)
+            {
+                ++mCursor.row;
+                seekPassing();
+            }
+            else
+            {
+                ++mIdx;
+                skipFiltered();
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {auto copy {*this}; ++*this; return copy;}
+
+        bool operator==(Iterator const& rhs) const
+        {
+            return mIdx == rhs.mIdx && mCursor == rhs.mCursor;
+        }
+
+    private:
+        friend class View;
+
+        Iterator(View const* view, bool atEnd) : mView{view}
+        {
+            if(view->mUseArchetypes)
+            {
+                if(atEnd) {mCursor = view->mArchetypeManager.endCursor();}
+                else {seekPassing();}
+                return;
+            }
+
+            view->getLeadEntities(mLeadEntities, mLeadSize, std::index_sequence_for<IncludeTs...>{});
+            mIdx = atEnd ? mLeadSize : 0;
+            skipFiltered();
+        }
+
+        void skipFiltered()
+        {
+            constexpr auto blockSize {ComponentPool::sTickBlockSize};
+            while(mIdx < mLeadSize)
+            {
+                if(mIdx % blockSize == 0 && !mView->leadBlockMayPass(mIdx))
+                {
+                    mIdx = std::min(mLeadSize, mIdx + blockSize);
+                    continue;
+                }
+
+                if(mView->matches((*mLeadEntities)[mIdx])) {return;}
+                ++mIdx;
+            }
+        }
+
+        void seekPassing()
+        {
+            auto& archetypes {mView->mArchetypeManager};
+            auto const& filter {mView->mFilter};
+            for(;;)
+            {
+                archetypes.seek(mCursor, mView->mIncluded, mView->mExcluded);
+                if(mCursor == archetypes.endCursor() || !filter.isActive()) {return;}
+
+                if(!archetypes.chunkMayPass(mCursor, filter))
+                {
+                    archetypes.skipChunk(mCursor);
+                    continue;
+                }
+
+                if(archetypes.passes(mCursor, filter)) {return;}
+                ++mCursor.row;
+            }
+        }
+
+        View const* mView{nullptr};
+
+        //Sparse set iteration state.
+        ChunkedArray<Entity> const* mLeadEntities{nullptr};
+        size_t mLeadSize{0};
+        size_t mIdx{0};
+
+        //Archetype iteration state.
+        ArchetypeManager::Cursor mCursor{};
+    };
+
+    Iterator begin() const {return {this, false};}
+    Iterator end() const {return {this, true};}
+
+private:
+
+    template <typename ComponentT>
+    static constexpr bool isIncluded() {return (std::is_same_v<ComponentT, IncludeTs> || ...);}
+
+    //Lead with the smallest pool since every entity has to be in it anyway. When the view is
+    //filtered, lead with the smallest filtered pool instead so that its clean blocks get skipped.
+    void pickLead()
+    {
+        std::array<size_t, sizeof...(IncludeTs)> const sizes {std::get<ComponentArray<IncludeTs>*>(mPools)->getSize()...};
+        std::array<bool, sizeof...(IncludeTs)> const isFiltered {isFilteredOn<IncludeTs>()...};
+
+        auto const anyFiltered {std::ranges::find(isFiltered, true) != isFiltered.end()};
+        mLeadIdx = sizes.size();
+        for(size_t i = 0; i < sizes.size(); ++i)
+        {
+            if(anyFiltered && !isFiltered[i]) {continue;}
+            if(mLeadIdx == sizes.size() || sizes[i] < sizes[mLeadIdx]) {mLeadIdx = i;}
+        }
+    }
+
+    template <typename ComponentT>
+    bool isFilteredOn() const
+    {
+        auto const id {GetIDFromType<ComponentT>()};
+        return mFilter.added.test(id) || mFilter.changed.test(id);
+    }
+
+    //False if nothing in the tick block of the pool starting at denseIdx can pass the filter.
+    template <typename ComponentT>
+    bool blockMayPass(ComponentArray<ComponentT>& pool, size_t denseIdx) const
+    {
+        if(!isFilteredOn<ComponentT>()) {return true;}
+        return mFilter.passes(GetIDFromType<ComponentT>(), pool.getBlockTicks(denseIdx / ComponentPool::sTickBlockSize));
+    }
+
+    bool leadBlockMayPass(size_t denseIdx) const
+    {
+        return leadBlockMayPass(denseIdx, std::index_sequence_for<IncludeTs...>{});
+    }
+
+    template <size_t ...Is>
+    bool leadBlockMayPass(size_t denseIdx, std::index_sequence<Is...>) const
+    {
+        bool mayPass {true};
+        ((Is == mLeadIdx ? (mayPass = blockMayPass(*std::get<Is>(mPools), denseIdx), true) : false) || ...);
+        return mayPass;
+    }
+
+    bool matches(Entity const& entity) const
+    {
+        auto const& signature {mEntityManager.getSignature(entity)};
+        return (signature & mIncluded) == mIncluded && (signature & mExcluded).none() &&
+            (!mFilter.isActive() || (passesFilter<IncludeTs>(entity) && ...));
+    }
+
+    template <typename ComponentT>
+    bool passesFilter(Entity const& entity) const
+    {
+        return mFilter.passes(GetIDFromType<ComponentT>(),
+            std::get<ComponentArray<ComponentT>*>(mPools)->getTicksUnchecked(entity));
+    }
+
+    template <size_t ...Is>
+    void getLeadEntities(ChunkedArray<Entity> const*& outEntities, size_t& outSize, std::index_sequence<Is...>) const
+    {
+        ((Is == mLeadIdx ? (outEntities = &std::get<Is>(mPools)->getEntityArray(),
+            outSize = std::get<Is>(mPools)->getSize(), true) : false) || ...);
+    }
+
+    //Pick the loop for the lead pool once, so that the inner loop is fully typed.
+    template <typename Func, size_t ...Is>
+    void eachWithLead(Func& fn, std::index_sequence<Is...>)
+    {
+        ((Is == mLeadIdx ? (eachFrom<Is>(fn), true) : false) || ...);
+    }
+
+    template <size_t LeadIdx, typename Func>
+    void eachFrom(Func& fn)
+    {
+        using LeadT = std::tuple_element_t<LeadIdx, std::tuple<IncludeTs...>>;
+        auto& lead {*std::get<LeadIdx>(mPools)};
+
+        constexpr auto chunkSize {ChunkedArray<LeadT>::sChunkSize};
+        constexpr auto blockSize {ComponentPool::sTickBlockSize};
+
+        for(size_t chunkIdx = 0; chunkIdx < lead.getChunkCount(); ++chunkIdx)
+        {
+            auto const entities {lead.getEntityChunk(chunkIdx)};
+            auto const components {lead.getComponentChunk(chunkIdx)};
+
+            for(size_t blockBegin = 0; blockBegin < entities.size(); blockBegin += blockSize)
+            {
+                if(!blockMayPass(lead, chunkIdx * chunkSize + blockBegin)) {continue;}
+
+                auto const blockEnd {std::min(entities.size(), blockBegin + blockSize)};
+                for(size_t i = blockBegin; i < blockEnd; ++i)
+                {
+                    auto const entity {entities[i]};
+                    if(!matches(entity)) {continue;}
+
+                    fn(entity, fetch<IncludeTs, LeadT>(components[i], entity)...);
+                }
+            }
+        }
+    }
+
+    static size_t pickGrainSize(size_t entityCount, size_t grainSize, ParallelMode mode)
+    {
+        if(mode == ParallelMode::DETERMINISTIC)
+            return grainSize;
+
+        //A few ranges per thread is enough to balance the load without paying per range overhead.
+        auto const threadCount {ThreadPool::get().getWorkerCount() + 1};
+        return std::max(grainSize, entityCount / (threadCount * 4));
+    }
+
+    template <typename Func>
+    static void invokeRanged(Func& fn, size_t rangeIdx, Entity const& entity, IncludeTs&... components)
+    {
+        if constexpr(std::is_invocable_v<Func&, size_t, Entity, IncludeTs&...>)
+            fn(rangeIdx, entity, components...);
+        else
+            fn(entity, components...);
+    }
+
+    template <typename Func, size_t ...Is>
+    size_t parallelEachWithLead(Func& fn, size_t grainSize, ParallelMode mode, std::index_sequence<Is...>)
+    {
+        size_t rangeCount {0};
+        ((Is == mLeadIdx ? (rangeCount = parallelEachFrom<Is>(fn, grainSize, mode), true) : false) || ...);
+        return rangeCount;
+    }
+
+    template <size_t LeadIdx, typename Func>
+    size_t parallelEachFrom(Func& fn, size_t grainSize, ParallelMode mode)
+    {
+        using LeadT = std::tuple_element_t<LeadIdx, std::tuple<IncludeTs...>>;
+        auto& lead {*std::get<LeadIdx>(mPools)};
+
+        auto const size {lead.getSize()};
+        auto const grain {pickGrainSize(size, grainSize, mode)};
+        auto const rangeCount {(size + grain - 1) / grain};
+
+        ThreadPool::get().parallelFor(rangeCount, [&](size_t rangeIdx)
+        {
+            constexpr auto blockSize {ComponentPool::sTickBlockSize};
+            auto const end {std::min(size, (rangeIdx + 1) * grain)};
+            for(size_t i = rangeIdx * grain; i < end;)
+            {
+                auto const blockEnd {std::min(end, (i / blockSize + 1) * blockSize)};
+                if(!blockMayPass(lead, i))
+                {
+                    i = blockEnd;
+                    continue;
+                }
+
+                for(; i < blockEnd; ++i)
+                {
+                    auto const entity {lead.entityAt(i)};
+                    if(!matches(entity)) {continue;}
+
+                    invokeRanged(fn, rangeIdx, entity, fetch<IncludeTs, LeadT>(lead.componentAt(i), entity)...);
+                }
+            }
+        });
+
+        return rangeCount;
+    }
+
+    //Archetype ranges are runs of whole chunks holding at least grainSize entities.
+    template <typename Func>
+    size_t parallelEachArchetypes(Func& fn, size_t grainSize, ParallelMode mode)
+    {
+        using ChunkColumns = std::tuple<ArchetypeManager::ChunkFilter, std::span<Entity const>, std::span<IncludeTs>...>;
+        std::vector<ChunkColumns> chunks;
+        size_t entityCount {0};
+
+        mArchetypeManager.eachFilteredChunk<IncludeTs...>([&](ArchetypeManager::ChunkFilter const& rows,
+            std::span<Entity const> entities, std::span<IncludeTs>... columns)
+        {
+            chunks.emplace_back(rows, entities, columns...);
+            entityCount += entities.size();
+        }, mExcluded, mFilter);
+
+        auto const grain {pickGrainSize(entityCount, grainSize, mode)};
+
+        std::vector<size_t> rangeStarts;
+        size_t rowsInRange {grain};
+        for(size_t i = 0; i < chunks.size(); ++i)
+        {
+            if(rowsInRange >= grain)
+            {
+                rangeStarts.push_back(i);
+                rowsInRange = 0;
+            }
+            rowsInRange += std::get<1>(chunks[i]).size();
+        }
+        rangeStarts.push_back(chunks.size());
+
+        auto const rangeCount {rangeStarts.size() - 1};
+        ThreadPool::get().parallelFor(rangeCount, [&](size_t rangeIdx)
+        {
+            for(size_t chunkIdx = rangeStarts[rangeIdx]; chunkIdx < rangeStarts[rangeIdx + 1]; ++chunkIdx)
+            {
+                std::apply([&](ArchetypeManager::ChunkFilter const& rows,
+                    std::span<Entity const> entities, std::span<IncludeTs>... columns)
+                {
+                    for(size_t row = 0; row < entities.size(); ++row)
+                    {
+                        if(rows.isActive() && !rows.passes(row)) {continue;}
+                        invokeRanged(fn, rangeIdx, entities[row], columns[row]...);
+                    }
+                }, chunks[chunkIdx]);
+            }
+        });
+
+        return rangeCount;
+    }
+
+    //The lead pool's component is already in hand, the others need a sparse lookup.
+    template <typename ComponentT, typename LeadT>
+    ComponentT& fetch(LeadT& leadComponent, Entity const& entity)
+    {
+        if constexpr(std::is_same_v<ComponentT, LeadT>)
+            return leadComponent;
+        else
+            return std::get<ComponentArray<ComponentT>*>(mPools)->getComponentUnchecked(entity);
+    }
+
+    EntityManager const& mEntityManager;
+    ComponentManager& mComponentManager;
+    ArchetypeManager& mArchetypeManager;
+    bool mUseArchetypes;
+
+    std::tuple<ComponentArray<IncludeTs>*...> mPools;
+    size_t mLeadIdx{0};
+
+    Signature_t mIncluded{makeSignature<IncludeTs...>()};
+    Signature_t mExcluded{makeSignature<ExcludeTs...>()};
+
+    TickFilter mFilter;
+};
+
+}
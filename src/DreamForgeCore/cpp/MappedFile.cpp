@@ -0,0 +1,143 @@
+#include "MappedFile.hpp"
+#include <utility>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace DF
+{
+
+#if defined(_WIN32)
+
+Expect<MappedFile> MappedFile::open(std::filesystem::path const& path)
+{
+    MappedFile file;
+
+    file.mFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if(file.mFile == INVALID_HANDLE_VALUE)
+    {
+        file.mFile = nullptr;
+        return std::unexpected(Error::Code::COULD_NOT_OPEN_FILE);
+    }
+
+    LARGE_INTEGER size{};
+    if(!GetFileSizeEx(file.mFile, &size) || size.QuadPart == 0)
+        return std::unexpected(Error::Code::COULD_NOT_OPEN_FILE);
+
+    file.mMapping = CreateFileMappingW(file.mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!file.mMapping)
+        return std::unexpected(Error::Code::COULD_NOT_OPEN_FILE);
+
+    file.mData = static_cast<std::byte const*>(MapViewOfFile(file.mMapping, FILE_MAP_READ, 0, 0, 0));
+    if(!file.mData)
+        return std::unexpected(Error::Code::COULD_NOT_OPEN_FILE);
+
+    file.mSize = static_cast<size_t>(size.QuadPart);
+    return file;
+}
+
+void MappedFile::close()
+{
+    if(mData) {UnmapViewOfFile(mData);}
+    if(mMapping) {CloseHandle(mMapping);}
+    if(mFile) {CloseHandle(mFile);}
+
+    mData = nullptr;
+    mMapping = nullptr;
+    mFile = nullptr;
+    mSize = 0;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : mData{std::exchange(other.mData, nullptr)}, mSize{std::exchange(other.mSize, 0)},
+      mFile{std::exchange(other.mFile, nullptr)}, mMapping{std::exchange(other.mMapping, nullptr)}
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if(this != &other)
+    {
+        close();
+        mData = std::exchange(other.mData, nullptr);
+        mSize = std::exchange(other.mSize, 0);
+        mFile = std::exchange(other.mFile, nullptr);
+        mMapping = std::exchange(other.mMapping, nullptr);
+    }
+    return *this;
+}
+
+#else
+
+Expect<MappedFile> MappedFile::open(std::filesystem::path const& path)
+{
+    auto const fd {::open(path.c_str(), O_RDONLY)};
+    if(fd == -1)
+        return std::unexpected(Error::Code::COULD_NOT_OPEN_FILE);
+
+    struct stat info{};
+    if(fstat(fd, &info) == -1 || info.st_size == 0)
+    {
+        ::close(fd);
+        return std::unexpected(Error::Code::COULD_NOT_OPEN_FILE);
+    }
+
+    auto* const data {mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0)};
+
+    //The mapping keeps the file alive on its own.
+    ::close(fd);
+
+    if(data == MAP_FAILED)
+        return std::unexpected(Error::Code::COULD_NOT_OPEN_FILE);
+
+    //Snapshots are read front to back.
+    madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+    MappedFile file;
+    file.mData = static_cast<std::byte const*>(data);
+    file.mSize = static_cast<size_t>(info.st_size);
+    return file;
+}
+
+void MappedFile::close()
+{
+    if(mData) {munmap(const_cast<std::byte*>(mData), mSize);}
+
+    mData = nullptr;
+    mSize = 0;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : mData{std::exchange(other.mData, nullptr)}, mSize{std::exchange(other.mSize, 0)}
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if(this != &other)
+    {
+        close();
+        mData = std::exchange(other.mData, nullptr);
+        mSize = std::exchange(other.mSize, 0);
+    }
+    return *this;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+}
@@ -0,0 +1,212 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace DF
+{
+
+//Which worker the current thread is. Threads that are not workers of the pool use the shared queue.
+static thread_local size_t tWorkerIdx {~size_t{0}};
+
+ThreadPool::ThreadPool()
+{
+    //Leave a core for the main thread.
+    auto const workerCount {std::max(1u, std::thread::hardware_concurrency()) - 1};
+
+    for(size_t i = 0; i < workerCount + 1; ++i)
+        mQueues.push_back(std::make_unique<TaskQueue>());
+
+    mWorkers.reserve(workerCount);
+    for(size_t i = 0; i < workerCount; ++i)
+        mWorkers.emplace_back([this, i]{workerLoop(i);});
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::scoped_lock lock {mSleepMutex};
+        mShuttingDown = true;
+    }
+    mWakeCondition.notify_all();
+
+    //the jthreads join on destruction
+    mWorkers.clear();
+}
+
+size_t ThreadPool::getCurrentThreadIndex() const
+{
+    return tWorkerIdx < mWorkers.size() ? tWorkerIdx : mWorkers.size();
+}
+
+void ThreadPool::GroupedTask::operator()()
+{
+    std::exception_ptr exception;
+    try
+    {
+        task();
+    }
+    catch(...)
+    {
+        exception = std::current_exception();
+    }
+
+    finishTask(*group, std::move(exception));
+}
+
+void ThreadPool::finishTask(TaskGroup& group, std::exception_ptr exception)
+{
+    //Under the lock, so the waiter cant see the group finish and destroy it before this is done with it.
+    std::scoped_lock lock {group.mutex};
+    if(exception && !group.exception) {group.exception = std::move(exception);}
+
+    group.pending.fetch_sub(1, std::memory_order_acq_rel);
+
+    //Every finished task can have submitted more, so wake the waiter to help with those too.
+    group.finished.notify_all();
+}
+
+void ThreadPool::submit(Task task, TaskGroup* group)
+{
+    if(group)
+    {
+        group->pending.fetch_add(1, std::memory_order_relaxed);
+        task = GroupedTask{std::move(task), group};
+    }
+
+    //Single threaded machine, so there are no workers to hand the task to.
+    if(mWorkers.empty())
+    {
+        task();
+        return;
+    }
+
+    {
+        //Count it before it is visible so a thief can never decrement first.
+        //Taking the lock orders the increment with a worker that is about to go to sleep.
+        std::scoped_lock lock {mSleepMutex};
+        mQueuedTaskCount.fetch_add(1, std::memory_order_release);
+    }
+
+    auto& queue {*mQueues[getCurrentThreadIndex()]};
+    {
+        std::scoped_lock lock {queue.mutex};
+        queue.tasks.push_back(std::move(task));
+    }
+
+    mWakeCondition.notify_one();
+}
+
+bool ThreadPool::tryRunTask(size_t threadIdx)
+{
+    Task task;
+
+    //Own queue first, newest task first since it is most likely still in cache.
+    {
+        auto& own {*mQueues[threadIdx]};
+        std::scoped_lock lock {own.mutex};
+        if(!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+
+    //Otherwise steal the oldest task from someone else.
+    for(size_t i = 1; !task && i < mQueues.size(); ++i)
+    {
+        auto& victim {*mQueues[(threadIdx + i) % mQueues.size()]};
+        std::scoped_lock lock {victim.mutex};
+        if(!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if(!task)
+        return false;
+
+    mQueuedTaskCount.fetch_sub(1, std::memory_order_relaxed);
+    task();
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t workerIdx)
+{
+    tWorkerIdx = workerIdx;
+
+    while(true)
+    {
+        if(tryRunTask(workerIdx))
+            continue;
+
+        std::unique_lock lock {mSleepMutex};
+        mWakeCondition.wait(lock, [this]
+        {
+            return mShuttingDown || mQueuedTaskCount.load(std::memory_order_acquire) > 0;
+        });
+
+        if(mShuttingDown)
+            return;
+    }
+}
+
+void ThreadPool::wait(TaskGroup& group)
+{
+    auto const threadIdx {getCurrentThreadIndex()};
+
+    while(group.pending.load(std::memory_order_acquire) > 0)
+    {
+        //Help out instead of blocking.
+        if(tryRunTask(threadIdx))
+            continue;
+
+        //Nothing to take, so the rest of the group is running elsewhere. Sleep until one of them
+        //finishes. The timeout catches tasks that get queued without one finishing first.
+        std::unique_lock lock {group.mutex};
+        group.finished.wait_for(lock, std::chrono::milliseconds{1},
+            [&group]{return group.pending.load(std::memory_order_acquire) == 0;});
+    }
+
+    //Taking the lock waits out the last task's finishTask(), so the group can be destroyed after this.
+    std::scoped_lock lock {group.mutex};
+    if(group.exception)
+        std::rethrow_exception(std::exchange(group.exception, nullptr));
+}
+
+void ThreadPool::parallelFor(size_t count, std::function<void(size_t)> const& body)
+{
+    if(count == 0)
+        return;
+
+    std::atomic<size_t> next {0};
+    auto const drain {[&next, count, &body]
+    {
+        for(size_t i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+            i = next.fetch_add(1, std::memory_order_relaxed))
+        {
+            body(i);
+        }
+    }};
+
+    //One task per worker that could help, and the calling thread takes part too.
+    TaskGroup group;
+    auto const helperCount {std::min(mWorkers.size(), count - 1)};
+    for(size_t i = 0; i < helperCount; ++i)
+        submit(drain, &group);
+
+    //Still wait for the helpers if this thread throws, they use next and body.
+    try
+    {
+        drain();
+    }
+    catch(...)
+    {
+        group.pending.fetch_add(1, std::memory_order_relaxed);
+        finishTask(group, std::current_exception());
+    }
+
+    wait(group);
+}
+
+}
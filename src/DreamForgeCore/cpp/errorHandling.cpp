@@ -14,7 +14,10 @@ std::string_view Error::getStr() const
     static std::unordered_map<Error::Code, std::string> errorStrings
     {
         {Code::MAX_ENTITIES_REACHED, "max entities reached"},
-        {Code::COULD_NOT_COMPILE_SHADERS, "could not compile shaders"}
+        {Code::COULD_NOT_COMPILE_SHADERS, "could not compile shaders"},
+        {Code::COULD_NOT_OPEN_FILE, "could not open file"},
+        {Code::INVALID_SNAPSHOT, "invalid or corrupt ECS snapshot"},
+        {Code::DELTA_JOURNAL_GAP, "the delta journal is missing frames, save a new snapshot and restart it"}
     };
     
     return errorStrings[m_code];
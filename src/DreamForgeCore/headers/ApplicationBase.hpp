@@ -3,6 +3,9 @@
 #include "df_export.hpp"
 #include "VulkanRenderer.hpp"
 #include "ErrorHandling.hpp"
+#include "SystemScheduler.hpp"
+#include "TransformHierarchy.hpp"
+#include "DeltaRecorder.hpp"
 #include <chrono>
 
 struct ImGuiContext;
@@ -33,6 +36,15 @@ public:
     };
     NonOwningPtr<ImGuiContext> getImGuiContext() const {return mImGuiContex.context;}
 
+    //Register the app's systems here. They run once per frame from run().
+    SystemScheduler& getSystems() {return mSystems;}
+
+    //World matrices of the entities with a Hierarchy, updated once per frame after the systems run.
+    TransformHierarchy const& getTransformHierarchy() const {return mTransformHierarchy;}
+
+    //Off until start() is called on it. While recording, every frame is captured at the end of run()'s sync point.
+    DeltaRecorder& getDeltaRecorder() {return mDeltaRecorder;}
+
 private:
 
     //begin and end of main engine loop
@@ -45,6 +57,9 @@ private:
     std::string_view const mTitle {"Dream Forge"};
     VulkanRenderer mRenderer {mWindow};
     guiContext mImGuiContex {mWindow.getRawWindow(), mRenderer};
+    SystemScheduler mSystems;
+    TransformHierarchy mTransformHierarchy;
+    DeltaRecorder mDeltaRecorder;
 
 public:
     ApplicationBase(ApplicationBase const&)=delete;
@@ -0,0 +1,45 @@
+#pragma once
+#include <filesystem>
+#include <span>
+#include <cstddef>
+#include "df_export.hpp"
+#include "errorHandling.hpp"
+
+namespace DF
+{
+
+//A read only view of a whole file mapped into memory. Pages are read in by the
+//OS the first time they are touched, so opening is cheap no matter the file size.
+class DF_DLL_API MappedFile
+{
+public:
+
+    //Returns COULD_NOT_OPEN_FILE if the file doesnt exist, is empty or cant be mapped.
+    static Expect<MappedFile> open(std::filesystem::path const& path);
+
+    MappedFile()=default;
+    ~MappedFile();
+
+    MappedFile(MappedFile const&)=delete;
+    MappedFile& operator=(MappedFile const&)=delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    std::span<std::byte const> getBytes() const {return {mData, mSize};}
+    size_t getSize() const {return mSize;}
+
+private:
+
+    void close();
+
+    std::byte const* mData{nullptr};
+    size_t mSize{0};
+
+#if defined(_WIN32)
+    //HANDLEs, kept as void* so this header doesnt need windows.h.
+    void* mFile{nullptr};
+    void* mMapping{nullptr};
+#endif
+};
+
+}
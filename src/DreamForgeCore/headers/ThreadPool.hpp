@@ -0,0 +1,113 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include "df_export.hpp"
+#include "HelpfulTypeAliases.hpp"
+
+namespace DF
+{
+
+//Counts the tasks of a group that have not finished yet, and keeps the first exception
+//one of them threw so ThreadPool::wait() can rethrow it.
+struct TaskGroup
+{
+    std::atomic<size_t> pending{0};
+
+    //Taken by every task of the group as it finishes, so wait() can sleep on finished.
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::exception_ptr exception;
+};
+
+//Work stealing thread pool. Every worker has its own deque of tasks. Workers
+//pop from the back of their own deque and, when it is empty, steal from the
+//front of the others. Threads that are not workers (the main thread) push to a
+//shared deque that the workers steal from too. Threads that wait on a TaskGroup
+//run tasks while they wait, and only sleep once there is nothing left to take.
+//
+//Tasks submitted with a group can throw, the exception comes out of wait(). A task
+//without a group that throws on a worker ends the program, like any other thread would.
+//
+//Singleton like the Logger. Avoids SIOF by being a local static inside of get().
+class DF_DLL_API ThreadPool
+{
+public:
+
+    using Task = std::function<void()>;
+
+    static ThreadPool& get()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    //Queue a task. If group is not null, it is counted as pending until the task finishes.
+    void submit(Task task, TaskGroup* group = nullptr);
+
+    //Run tasks on the calling thread until every task in the group has finished.
+    //Rethrows the first exception a task of the group threw, once all of them are done.
+    void wait(TaskGroup& group);
+
+    //Calls body(i) for every i in [0, count) across the workers and the calling thread,
+    //and returns once they have all finished. Threads grab the next index as they go,
+    //so uneven work balances itself out. Keep each body(i) reasonably large.
+    //If body throws, the first exception is rethrown after every thread has stopped.
+    void parallelFor(size_t count, std::function<void(size_t)> const& body);
+
+    auto getWorkerCount() const {return mWorkers.size();}
+
+    //Worker threads are numbered [0, getWorkerCount()). Every other thread gets getWorkerCount().
+    //Useful for indexing per thread data with getWorkerCount() + 1 slots.
+    size_t getCurrentThreadIndex() const;
+
+private:
+
+    ThreadPool();
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&)=delete;
+    ThreadPool(ThreadPool&&)=delete;
+    ThreadPool& operator=(ThreadPool const&)=delete;
+    ThreadPool& operator=(ThreadPool&&)=delete;
+
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(size_t workerIdx);
+
+    //Pop from the back of our own queue, or steal from the front of another.
+    bool tryRunTask(size_t threadIdx);
+
+    //One per worker and one more shared by all other threads (the last one).
+    std::vector<std::unique_ptr<TaskQueue>> mQueues;
+    std::vector<std::jthread> mWorkers;
+
+    //Idle workers sleep on this until something is submitted.
+    std::mutex mSleepMutex;
+    std::condition_variable mWakeCondition;
+    std::atomic<size_t> mQueuedTaskCount{0};
+    bool mShuttingDown{false};
+
+    //Wraps a task so that it is counted by a group.
+    struct GroupedTask
+    {
+        Task task;
+        TaskGroup* group;
+        void operator()();
+    };
+
+    //Marks one task of group as done, keeping exception if it is the first one.
+    static void finishTask(TaskGroup& group, std::exception_ptr exception);
+};
+
+}
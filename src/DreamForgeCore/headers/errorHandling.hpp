@@ -47,7 +47,10 @@ public:
     {
         NONE = 0,
         MAX_ENTITIES_REACHED,
-        COULD_NOT_COMPILE_SHADERS
+        COULD_NOT_COMPILE_SHADERS,
+        COULD_NOT_OPEN_FILE,
+        INVALID_SNAPSHOT,
+        DELTA_JOURNAL_GAP
     };
 
     Error(Code code) : m_code{code} {}